@@ -0,0 +1,297 @@
+/**
+ * @file accuracy_sweep.h
+ *
+ * Accuracy sweeps of unary floating-point functions against a reference
+ *
+ * A sweep evaluates a candidate function and a reference function over
+ * a set of inputs, and collects the maximum ULP error, the input where
+ * it occurs, and a histogram of the errors (see float_accuracy.h for
+ * the definition of ULP error used here).
+ *
+ * - sweep_float_all:    all 2^32 float inputs (including NaN and Inf)
+ * - sweep_float_range:  all float inputs in [lo, hi]
+ * - sweep_double_range: a stratified sample of double inputs in [lo, hi]
+ *
+ * Inputs are split into chunks which are processed by a pool of threads.
+ * The results do not depend on the number of threads.
+ *
+ * @author Dahua Lin
+ */
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#ifndef LIGHT_TEST_ACCURACY_SWEEP_H_
+#define LIGHT_TEST_ACCURACY_SWEEP_H_
+
+#include "float_accuracy.h"
+#include "prng.h"
+#include "str_template.h"
+
+#include <atomic>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+// the number of inputs in a chunk (the unit of work of a thread)
+#ifndef LTEST_SWEEP_CHUNK_SIZE
+#define LTEST_SWEEP_CHUNK_SIZE 65536
+#endif
+
+namespace ltest
+{
+
+	/************************************************
+	 *
+	 *  Sweep results
+	 *
+	 ************************************************/
+
+	template<typename T>
+	struct sweep_result
+	{
+		uint64_t num_checked;
+		uint64_t max_ulp;		// the maximum ULP error
+		T worst_arg;			// the (first) input that attains max_ulp
+		T worst_expected;		// reference value at worst_arg
+		T worst_actual;			// candidate value at worst_arg
+		uint64_t worst_index;	// position of worst_arg in the sweep
+		ulp_histogram hist;
+
+		sweep_result()
+		: num_checked(0), max_ulp(0)
+		, worst_arg(0), worst_expected(0), worst_actual(0), worst_index(0)
+		{
+		}
+
+		void merge(const sweep_result& other)
+		{
+			if (other.num_checked == 0) return;
+
+			if (num_checked == 0 || other.max_ulp > max_ulp ||
+				(other.max_ulp == max_ulp && other.worst_index < worst_index))
+			{
+				max_ulp = other.max_ulp;
+				worst_arg = other.worst_arg;
+				worst_expected = other.worst_expected;
+				worst_actual = other.worst_actual;
+				worst_index = other.worst_index;
+			}
+
+			num_checked += other.num_checked;
+			hist.merge(other.hist);
+		}
+
+		std::string str() const
+		{
+			std::string s = sformat((unsigned long long)num_checked, "%llu inputs checked, ");
+			s += sformat((unsigned long long)max_ulp, "max ULP error = %llu");
+
+			if (max_ulp > 0)
+			{
+				s += sformat((double)worst_arg, " at x = %.17g");
+				s += sformat((double)worst_actual, " (%.17g");
+				s += sformat((double)worst_expected, " vs %.17g)");
+			}
+
+			for (unsigned int k = 0; k < ulp_histogram::nbins; ++k)
+			{
+				if (hist.count(k) == 0) continue;
+
+				s += "\n  ";
+				if (k <= 1)
+					s += sformat(k, "%u");
+				else if (k < 64)
+					s += sformat((unsigned long long)1 << (k-1), "[%llu, ") +
+						 sformat((unsigned long long)1 << k, "%llu)");
+				else
+					s += sformat((unsigned long long)1 << 63, ">= %llu");
+
+				s += sformat((unsigned long long)hist.count(k), " ulp: %llu");
+			}
+			return s;
+		}
+	};
+
+
+	namespace detail
+	{
+		// generators: the k-th input of a sweep
+
+		struct float_all_gen
+		{
+			float operator() (uint64_t k) const
+			{
+				uint32_t u = (uint32_t)k;
+				float x;
+				std::memcpy(&x, &u, sizeof(float));
+				return x;
+			}
+		};
+
+		template<typename T>
+		struct ordered_range_gen
+		{
+			int64_t first;
+
+			T operator() (uint64_t k) const
+			{
+				return internal::from_ordered<T>((typename internal::ulp_repr<T>::sint_t)(first + (int64_t)k));
+			}
+		};
+
+		// the range is divided into n strata of (nearly) equal numbers of
+		// representable values, and one input is drawn from each of them
+		template<typename T>
+		struct stratified_gen
+		{
+			int64_t first;
+			uint64_t span;
+			uint64_t n;
+			uint64_t seed;
+
+			T operator() (uint64_t k) const
+			{
+				uint64_t q = span / n;
+				uint64_t r = span % n;
+				uint64_t b = q * k + (k < r ? k : r);
+				uint64_t w = q + (k < r ? 1 : 0);
+				uint64_t off = b + splitmix64(seed ^ splitmix64(k)) % w;
+				return internal::from_ordered<T>((typename internal::ulp_repr<T>::sint_t)(first + (int64_t)off));
+			}
+		};
+
+
+		template<typename T, class Gen, class Ref, class Fun>
+		void sweep_chunk(uint64_t begin, uint64_t end, const Gen& gen, const Ref& ref, const Fun& f,
+				sweep_result<T>& res)
+		{
+			typedef typename internal::ulp_repr<T>::uint_t uint_t;
+			const size_t bsiz = 1024;
+
+			T x[bsiz];
+			T y[bsiz];
+			T r[bsiz];
+			uint_t d[bsiz];
+
+			for (uint64_t i = begin; i < end; i += bsiz)
+			{
+				size_t m = end - i < bsiz ? (size_t)(end - i) : bsiz;
+
+				for (size_t j = 0; j < m; ++j) x[j] = gen(i + j);
+				for (size_t j = 0; j < m; ++j) r[j] = static_cast<T>(ref(x[j]));
+				for (size_t j = 0; j < m; ++j) y[j] = static_cast<T>(f(x[j]));
+
+				ulp_diffs(m, y, r, d);
+
+				for (size_t j = 0; j < m; ++j)
+				{
+					res.hist.add(d[j]);
+					if (d[j] > res.max_ulp || res.num_checked + j == 0)
+					{
+						res.max_ulp = d[j];
+						res.worst_arg = x[j];
+						res.worst_expected = r[j];
+						res.worst_actual = y[j];
+						res.worst_index = i + j;
+					}
+				}
+				res.num_checked += m;
+			}
+		}
+
+		template<typename T, class Gen, class Ref, class Fun>
+		sweep_result<T> run_sweep(uint64_t n, const Gen& gen, const Ref& ref, const Fun& f, unsigned int nthreads)
+		{
+			const uint64_t csiz = LTEST_SWEEP_CHUNK_SIZE;
+			uint64_t nchunks = (n + csiz - 1) / csiz;
+
+			if (nthreads == 0) nthreads = std::thread::hardware_concurrency();
+			if (nthreads == 0) nthreads = 1;
+			if (nthreads > nchunks) nthreads = (unsigned int)(nchunks > 0 ? nchunks : 1);
+
+			std::vector<sweep_result<T> > results(nthreads);
+			std::atomic<uint64_t> next_chunk(0);
+
+			auto worker = [&](unsigned int t)
+			{
+				uint64_t c;
+				while ((c = next_chunk++) < nchunks)
+				{
+					uint64_t begin = c * csiz;
+					uint64_t end = n - begin < csiz ? n : begin + csiz;
+					sweep_chunk(begin, end, gen, ref, f, results[t]);
+				}
+			};
+
+			std::vector<std::thread> threads;
+			for (unsigned int t = 1; t < nthreads; ++t) threads.push_back(std::thread(worker, t));
+			worker(0);
+			for (size_t t = 0; t < threads.size(); ++t) threads[t].join();
+
+			sweep_result<T> res;
+			for (unsigned int t = 0; t < nthreads; ++t) res.merge(results[t]);
+			return res;
+		}
+	}
+
+
+	/************************************************
+	 *
+	 *  Sweeps
+	 *
+	 *  ref and f are callables taking a T; the result
+	 *  of ref is converted to T before comparison, so a
+	 *  float function may be checked against a double
+	 *  precision reference. Both are invoked concurrently
+	 *  from multiple threads (nthreads = 0 uses all
+	 *  hardware threads).
+	 *
+	 ************************************************/
+
+	template<class Ref, class Fun>
+	inline sweep_result<float> sweep_float_all(const Ref& ref, const Fun& f, unsigned int nthreads = 0)
+	{
+		return detail::run_sweep<float>((uint64_t)1 << 32, detail::float_all_gen(), ref, f, nthreads);
+	}
+
+	template<class Ref, class Fun>
+	inline sweep_result<float> sweep_float_range(const Ref& ref, const Fun& f, float lo, float hi,
+			unsigned int nthreads = 0)
+	{
+		if (!(lo <= hi))
+			throw std::invalid_argument("sweep_float_range: lo <= hi is required.");
+
+		detail::ordered_range_gen<float> gen;
+		gen.first = internal::to_ordered(lo);
+		uint64_t n = (uint64_t)((int64_t)internal::to_ordered(hi) - gen.first) + 1;
+
+		return detail::run_sweep<float>(n, gen, ref, f, nthreads);
+	}
+
+	/**
+	 * Checks n inputs in [lo, hi] (lo and hi finite), one drawn at random
+	 * from each of n strata with equal numbers of representable values.
+	 * The inputs are therefore spread evenly over the binades, and are
+	 * fully determined by seed.
+	 */
+	template<class Ref, class Fun>
+	inline sweep_result<double> sweep_double_range(const Ref& ref, const Fun& f, double lo, double hi,
+			uint64_t n, uint64_t seed = 0, unsigned int nthreads = 0)
+	{
+		if (!(lo <= hi) || std::isinf(lo) || std::isinf(hi))
+			throw std::invalid_argument("sweep_double_range: finite lo <= hi is required.");
+
+		detail::stratified_gen<double> gen;
+		gen.first = internal::to_ordered(lo);
+		gen.span = (uint64_t)internal::to_ordered(hi) - (uint64_t)gen.first + 1;
+		gen.n = n < gen.span ? n : gen.span;
+		gen.seed = seed;
+
+		return detail::run_sweep<double>(gen.n, gen, ref, f, nthreads);
+	}
+
+}
+
+#endif /* ACCURACY_SWEEP_H_ */
@@ -50,11 +50,38 @@ namespace ltest
 			register_testpack(m_ppack);
 		}
 
+		auto_test_pack(const char* name, test_fixture* pfixture)
+		{
+			m_ppack = new test_pack(name);
+			m_ppack->set_fixture(pfixture);
+			register_testpack(m_ppack);
+		}
+
 		void add(test_case* pcase)
 		{
 			m_ppack->add(pcase);
 		}
 
+		void add(const char *name, test_factory_t factory)
+		{
+			m_ppack->add(name, factory);
+		}
+
+		void add(const char *name, test_func_t func, const char *file, unsigned int line)
+		{
+			m_ppack->add(name, func, file, line);
+		}
+
+		void add(test_case_group* pgroup)
+		{
+			m_ppack->add(pgroup);
+		}
+
+		void reserve_funcs(size_t n)
+		{
+			m_ppack->reserve_funcs(n);
+		}
+
 	private:
 		auto_test_pack(const auto_test_pack& );
 		auto_test_pack& operator = (const auto_test_pack& );
@@ -63,6 +90,16 @@ namespace ltest
 		test_pack* m_ppack;
 	};
 
+
+	class auto_suite_fixture
+	{
+	public:
+		explicit auto_suite_fixture(test_fixture* pfixture)
+		{
+			auto_main_suite().set_fixture(pfixture);
+		}
+	};
+
 }
 
 // Useful macros
@@ -76,7 +113,27 @@ namespace ltest
 	ltest_pack_##PackName::ltest_pack_##PackName() : ltest::auto_test_pack( #PackName )
 
 
-#define ADD_TESTCASE( ClassName ) this->add(new ClassName());
+// the fixture object is constructed at static initialization,
+// so expensive work belongs to its set_up
+
+#define AUTO_TPACK_F( PackName, FixtureClass ) \
+	class ltest_pack_##PackName : public ltest::auto_test_pack { \
+	public: \
+		ltest_pack_##PackName(); }; \
+	ltest_pack_##PackName ltest_pack_##PackName##_instance; \
+	ltest_pack_##PackName::ltest_pack_##PackName() : ltest::auto_test_pack( #PackName, new FixtureClass() )
+
+#define AUTO_SUITE_FIXTURE( FixtureClass ) \
+	ltest::auto_suite_fixture ltest_suite_fixture_instance( new FixtureClass() );
+
+
+#define ADD_TESTCASE( ClassName ) this->add(#ClassName, &::ltest::make_test_case< ClassName >);
+
+#define ADD_TESTCASE_AS( Name, ClassName ) this->add(Name, &::ltest::make_test_case< ClassName >);
+
+#define ADD_TESTFUNC( Func ) this->add(#Func, &Func, __FILE__, __LINE__);
+
+#define ADD_TESTFUNC_AS( Name, ... ) this->add(Name, __VA_ARGS__, __FILE__, __LINE__);
 
 
 #endif 
@@ -13,55 +13,61 @@
 #ifndef LIGHT_TEST_BASE_H_
 #define LIGHT_TEST_BASE_H_
 
+// Light-Test requires C++11 (with its standard library)
+
 #if (defined(_WIN32) || defined(_WIN64)) && defined(_MSC_VER)
-	#if _MSC_VER < 1600
-		#error Microsoft Visual C++ of version lower than MSVC 2010 is not supported.
+	#if _MSC_VER < 1800
+		#error Microsoft Visual C++ of version lower than MSVC 2013 is not supported.
 	#endif
 	#define LTEST_USE_C11_STDLIB
 
 #elif (defined(__GNUC__))
 
 	#if (defined(__clang__))
-		#if ((__clang_major__ < 2) || (__clang_major__ == 2 && __clang_minor__ < 8))
-			#error CLANG of version lower than 2.8.0 is not supported
+		#if ((__clang_major__ < 3) || (__clang_major__ == 3 && __clang_minor__ < 1))
+			#error CLANG of version lower than 3.1.0 is not supported
 		#endif
 	#else
-		#if ((__GNUC__ < 4) || (__GNUC__ == 4 && __GNUC_MINOR__ < 2))
-			#error GCC of version lower than 4.2.0 is not supported
+		#if ((__GNUC__ < 4) || (__GNUC__ == 4 && __GNUC_MINOR__ < 7))
+			#error GCC of version lower than 4.7.0 is not supported
 		#endif
 	#endif
 
-	#if (defined(__GXX_EXPERIMENTAL_CXX0X__))
-		#define LTEST_USE_C11_STDLIB
+	#if !(defined(__GXX_EXPERIMENTAL_CXX0X__) || __cplusplus >= 201103L)
+		#error Light-Test requires C++11 (e.g. -std=c++0x or -std=c++11)
 	#endif
+	#define LTEST_USE_C11_STDLIB
 
 #else
 	#error Light-Test can only be used with Microsoft Visual C++, GCC (G++), or clang (clang++).
 #endif
 
+// thread-local storage for trivially constructible objects,
+// and functions kept out of the callers' hot paths
+
+#if defined(_MSC_VER)
+	#define LTEST_THREAD_LOCAL __declspec(thread)
+	#define LTEST_NOINLINE __declspec(noinline)
+#else
+	#define LTEST_THREAD_LOCAL __thread
+	#define LTEST_NOINLINE __attribute__((noinline, cold))
+#endif
+
 #include <cstddef>
 #include <string>
 #include <exception>
 #include <iosfwd>
-
-#if defined(LTEST_USE_C11_STDLIB)
 #include <memory>
-#else
-#include <tr1/memory>
-#endif
 
 
 namespace ltest
 {
 	using std::size_t;
 
-#if defined(LTEST_USE_C11_STDLIB)
 	using std::shared_ptr;
-#else
-	using std::tr1::shared_ptr;
-#endif
 
 	class assertion_failure;
+	struct expectation_log;
 
 	class test_case;
 	class test_pack;
@@ -0,0 +1,230 @@
+/**
+ * @file bench_group.h
+ *
+ * @brief Side-by-side comparison of benchmark jobs
+ *
+ * A bench_group holds jobs that do the same work in different ways
+ * (e.g. two implementations of a hash map). Each job is warmed up and
+ * given a batch size as in run_benchmark. The jobs are then measured in
+ * rounds, each of which runs a batch of every job, in an order shuffled
+ * anew for every round, so that a drift of the machine (e.g. of the
+ * clock frequency, or of other load) affects all jobs alike.
+ *
+ * The speedup of a job is the time per element of the baseline job
+ * over that of the job. It is estimated by the geometric mean of the
+ * ratios within the rounds, with a 95% confidence interval. The rounds
+ * stop as soon as the interval of every job is within about +/- rel_ci
+ * of its speedup, provided that min_batches rounds have been run and
+ * every job has been timed for min_time seconds. They stop once
+ * time_thres seconds per job have been spent in any case, though at
+ * least two rounds are always run, as one round gives no interval.
+ *
+ * @author Dahua Lin
+ */
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#ifndef LIGHT_TEST_BENCH_GROUP_H_
+#define LIGHT_TEST_BENCH_GROUP_H_
+
+#include "benchmark.h"
+#include "roofline.h"
+#include "prng.h"
+
+#include <cmath>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace ltest
+{
+
+	namespace detail
+	{
+		/**
+		 * A copy of a job in a bench_group, with its declarations.
+		 * It runs batches as in run_benchmark.
+		 */
+		class bench_group_job
+		{
+		public:
+			template<class Job>
+			explicit bench_group_job(const Job& job)
+			: m_name(job.name())
+			, m_size(job.size())
+			, m_traffic(job_traffic::of(job))
+			, m_batch([job](size_t n, timer& tm)
+				{
+					tm.start();
+					for (size_t i = 0; i < n; ++i) job();
+					return tm.elapsed_secs();
+				})
+			{
+			}
+
+			const char *name() const
+			{
+				return m_name.c_str();
+			}
+
+			size_t size() const
+			{
+				return m_size;
+			}
+
+			double bytes_read() const
+			{
+				return m_traffic.bytes_read;
+			}
+
+			double bytes_written() const
+			{
+				return m_traffic.bytes_written;
+			}
+
+			double flops() const
+			{
+				return m_traffic.flops;
+			}
+
+			double operator() (size_t n, timer& tm) const
+			{
+				return m_batch(n, tm);
+			}
+
+		private:
+			std::string m_name;
+			size_t m_size;
+			job_traffic m_traffic;
+			std::function<double(size_t, timer&)> m_batch;
+		};
+	}
+
+
+	class bench_group
+	{
+	public:
+		bench_group()
+		: m_baseline(0)
+		{
+		}
+
+		// the job is copied, and should be cheap to copy
+		template<class Job>
+		bench_group& add(const Job& job)
+		{
+			m_jobs.push_back(detail::bench_group_job(job));
+			return *this;
+		}
+
+		// the index of the baseline job (by default, the first one added)
+		bench_group& set_baseline(size_t i)
+		{
+			m_baseline = i;
+			return *this;
+		}
+
+		size_t size() const
+		{
+			return m_jobs.size();
+		}
+
+		size_t baseline() const
+		{
+			return m_baseline;
+		}
+
+		/**
+		 * Runs the comparison, and reports every job (in the order
+		 * they were added). The order of the jobs within the rounds
+		 * is drawn from a generator seeded by seed.
+		 */
+		template<class Monitor>
+		void run(Monitor& mon, const benchmark_option& option, uint64_t seed = 0) const
+		{
+			const size_t m = m_jobs.size();
+			if (m == 0) return;
+			const size_t b = m_baseline < m ? m_baseline : 0;
+			numa_scope placement(option.cpu_node, option.mem_node);
+
+			// warming
+
+			std::vector<size_t> bsiz(m);
+			for (size_t j = 0; j < m; ++j)
+			{
+				bench_stats st;
+				bsiz[j] = detail::warm_up_bench(option, m_jobs[j], st);
+			}
+
+			// measuring
+
+			std::vector<size_t> order(m);
+			for (size_t j = 0; j < m; ++j) order[j] = j;
+
+			std::vector<double> et(m, 0.0);
+			std::vector<double> tpe(m);
+			std::vector<detail::batch_stats> lr(m);	// the logs of speedups
+
+			xoshiro256ss rng(seed);
+			timer tm;
+			double total = 0.0;
+			size_t k = 0;
+
+			if (option.profiler) option.profiler->start();
+
+			for(;;)
+			{
+				for (size_t i = m - 1; i > 0; --i) std::swap(order[i], order[(size_t)rng.below(i + 1)]);
+
+				for (size_t i = 0; i < m; ++i)
+				{
+					size_t j = order[i];
+					double t = m_jobs[j](bsiz[j], tm);
+					et[j] += t;
+					total += t;
+					tpe[j] = t / double(bsiz[j] * m_jobs[j].size());
+				}
+				++k;
+
+				for (size_t j = 0; j < m; ++j) lr[j].add(std::log(tpe[b] / tpe[j]));
+
+				if (k >= 2 && total >= option.time_thres * double(m)) break;
+
+				if (option.rel_ci > 0 && k >= option.min_batches && converged(lr, et, option)) break;
+			}
+
+			if (option.profiler) option.profiler->stop();
+
+			// reporting
+
+			for (size_t j = 0; j < m; ++j)
+			{
+				double u = lr[j].mean();
+				double h = lr[j].ci();
+				bench_relative r = { m_jobs[b].name(), std::exp(u), std::exp(u - h), std::exp(u + h), k };
+
+				detail::report_with(mon, m_jobs[j], k * bsiz[j], runtime_span::from_secs(et[j]), r, 0);
+			}
+		}
+
+	private:
+		static bool converged(const std::vector<detail::batch_stats>& lr, const std::vector<double>& et,
+				const benchmark_option& option)
+		{
+			for (size_t j = 0; j < lr.size(); ++j)
+			{
+				if (et[j] < option.min_time || lr[j].ci() > option.rel_ci) return false;
+			}
+			return true;
+		}
+
+	private:
+		std::vector<detail::bench_group_job> m_jobs;
+		size_t m_baseline;
+	};
+
+}
+
+#endif /* BENCH_GROUP_H_ */
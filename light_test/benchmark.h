@@ -15,8 +15,13 @@
 
 #include "base.h"
 #include "timer.h"
+#include "latency_histogram.h"
+#include "sampling_profiler.h"
+#include "numa.h"
 #include <iostream>
+#include <algorithm>
 #include <cmath>
+#include <vector>
 
 namespace ltest
 {
@@ -27,6 +32,26 @@ namespace ltest
 			name = v; \
 			return *this; }
 
+	/**
+	 * run_benchmark runs batches of (batch_ratio * time_thres) seconds,
+	 * and stops as soon as the 95% confidence interval of the mean batch
+	 * time is within +/- rel_ci of the mean, provided that min_time seconds
+	 * and min_batches batches have been spent. It stops at time_thres
+	 * seconds in any case. With rel_ci = 0, it always runs time_thres
+	 * seconds.
+	 *
+	 * Before that, the job is warmed up by warming_runs calls, and then
+	 * by batches until the last warming_window batch times show no trend
+	 * (see detail::is_steady), or max_warming_time seconds have passed.
+	 * With warming_window = 0, only the warming_runs calls are made.
+	 *
+	 * If a profiler is given, it samples the measured batches (of all
+	 * the runs it is given to, until it is cleared).
+	 *
+	 * With cpu_node >= 0, the running thread is bound to the CPUs of that
+	 * NUMA node during the run, and with mem_node >= 0, the memory that
+	 * the job allocates during the run comes from that node (see numa.h).
+	 */
 	struct benchmark_option
 	{
 		_LTEST_DEFINE_OPTION_FIELD( size_t, probe_batch_size )
@@ -34,17 +59,191 @@ namespace ltest
 		_LTEST_DEFINE_OPTION_FIELD( size_t, warming_runs )
 		_LTEST_DEFINE_OPTION_FIELD( double, time_thres )
 		_LTEST_DEFINE_OPTION_FIELD( double, batch_ratio )
+		_LTEST_DEFINE_OPTION_FIELD( double, min_time )
+		_LTEST_DEFINE_OPTION_FIELD( size_t, min_batches )
+		_LTEST_DEFINE_OPTION_FIELD( double, rel_ci )
+		_LTEST_DEFINE_OPTION_FIELD( size_t, warming_window )
+		_LTEST_DEFINE_OPTION_FIELD( double, warming_tol )
+		_LTEST_DEFINE_OPTION_FIELD( double, max_warming_time )
+		_LTEST_DEFINE_OPTION_FIELD( sampling_profiler*, profiler )
+		_LTEST_DEFINE_OPTION_FIELD( int, cpu_node )
+		_LTEST_DEFINE_OPTION_FIELD( int, mem_node )
 
 		explicit benchmark_option(size_t bsize0)
 		: probe_batch_size(bsize0)
 		, max_batch_size(2000000000)
-		, warming_runs(5)
+		, warming_runs(1)
 		, time_thres(0.5)
-		, batch_ratio(0.1)
+		, batch_ratio(0.01)
+		, min_time(0.05)
+		, min_batches(10)
+		, rel_ci(0.01)
+		, warming_window(8)
+		, warming_tol(0.02)
+		, max_warming_time(0.25)
+		, profiler(0)
+		, cpu_node(-1)
+		, mem_node(-1)
 		{ }
 	};
 
 
+	/**
+	 * The details of a run, which are passed to the monitor
+	 * as a fourth argument if it accepts one
+	 */
+	struct bench_stats
+	{
+		size_t warmup_runs;		// the calls made before measuring
+		double warmup_secs;		// the time spent on them
+		bool warmup_steady;		// whether the warmup ended in a steady state
+		size_t num_batches;
+		double rel_ci;			// relative half-width of the 95% CI of the batch mean
+	};
+
+
+	/**
+	 * The time of a job relative to the baseline of a bench_group, which
+	 * is passed to the monitor as a fourth argument if it accepts one
+	 */
+	struct bench_relative
+	{
+		const char *baseline;	// the name of the baseline job
+		double speedup;			// baseline time / job time (per element)
+		double speedup_lo;		// the 95% confidence interval of speedup
+		double speedup_hi;
+		size_t rounds;
+	};
+
+
+	namespace detail
+	{
+		// the 97.5% quantile of Student's t distribution with df degrees
+		// of freedom (a Cornish-Fisher expansion, within 1% for df >= 4)
+		inline double student_t975(size_t df)
+		{
+			static const double table[4] = { 12.706, 4.303, 3.182, 2.776 };
+			if (df == 0) return 1.0e300;
+			if (df <= 4) return table[df - 1];
+
+			const double z = 1.959964;
+			double z3 = z * z * z;
+			double z5 = z3 * z * z;
+			double d = double(df);
+			return z + (z3 + z) / (4.0 * d) + (5.0 * z5 + 16.0 * z3 + 3.0 * z) / (96.0 * d * d);
+		}
+
+		// running mean and variance of batch times (Welford's method)
+		class batch_stats
+		{
+		public:
+			batch_stats()
+			: m_n(0), m_mean(0.0), m_m2(0.0)
+			{
+			}
+
+			void add(double x)
+			{
+				++ m_n;
+				double d = x - m_mean;
+				m_mean += d / double(m_n);
+				m_m2 += d * (x - m_mean);
+			}
+
+			size_t count() const
+			{
+				return m_n;
+			}
+
+			double mean() const
+			{
+				return m_mean;
+			}
+
+			double variance() const
+			{
+				return m_n > 1 ? m_m2 / double(m_n - 1) : 0.0;
+			}
+
+			// the half-width of the 95% confidence interval of the mean,
+			// relative to the mean
+			double rel_ci() const
+			{
+				if (m_n < 2 || m_mean <= 0.0) return 1.0e300;
+				return ci() / m_mean;
+			}
+
+			// the half-width of the 95% confidence interval of the mean
+			double ci() const
+			{
+				if (m_n < 2) return 1.0e300;
+				return student_t975(m_n - 1) * std::sqrt(variance() / double(m_n));
+			}
+
+		private:
+			size_t m_n;
+			double m_mean;
+			double m_m2;
+		};
+
+		inline double median_of(std::vector<double>& v)
+		{
+			size_t n = v.size();
+			std::sort(v.begin(), v.end());
+			return n % 2 ? v[n / 2] : 0.5 * (v[n / 2 - 1] + v[n / 2]);
+		}
+
+		/**
+		 * Whether the batch times t[0], ..., t[w-1] (oldest first) show no
+		 * trend, i.e. the medians of the older and the newer halves differ
+		 * by at most tol (relative to the newer half), or by less than twice
+		 * the standard error of the difference. The noise level is estimated
+		 * by the median absolute deviation, so that a few outliers (e.g. page
+		 * faults) neither hide a trend nor suggest one.
+		 */
+		inline bool is_steady(const double *t, size_t w, double tol)
+		{
+			size_t h = w / 2;
+			if (h == 0) return true;
+
+			std::vector<double> u(t, t + h);
+			double ma = median_of(u);
+			u.assign(t + (w - h), t + w);
+			double mb = median_of(u);
+
+			double d = std::fabs(ma - mb);
+			if (d <= tol * mb) return true;
+
+			u.assign(t, t + w);
+			double m = median_of(u);
+			for (size_t i = 0; i < w; ++i) u[i] = std::fabs(t[i] - m);
+			double sigma = 1.4826 * median_of(u);
+
+			// the standard error of a median is about 1.25 sigma / sqrt(h)
+			double se = 1.25 * sigma * std::sqrt(2.0 / double(h));
+			return d < 2.0 * se;
+		}
+
+		// passes the extra results of a run (bench_stats, bench_relative,
+		// load_result, ...) to monitors that accept them as a fourth
+		// argument, and calls mon(job, n, span) otherwise
+
+		template<class Monitor, class Job, class Extra>
+		inline auto report_with(Monitor& mon, const Job& job, size_t n, const runtime_span& span,
+				const Extra& extra, int) -> decltype(mon(job, n, span, extra), void())
+		{
+			mon(job, n, span, extra);
+		}
+
+		template<class Monitor, class Job, class Extra>
+		inline void report_with(Monitor& mon, const Job& job, size_t n, const runtime_span& span,
+				const Extra& extra, long)
+		{
+			mon(job, n, span);
+		}
+	}
+
+
 	inline size_t determine_bench_batch_size(const benchmark_option& option, double probe_time)
 	{
 		double bt = option.batch_ratio * option.time_thres;
@@ -78,39 +277,200 @@ namespace ltest
 	}
 
 
+	namespace detail
+	{
+		// warms up a job under the rules of the option, where batch(n, tm)
+		// makes n calls and returns the seconds timed by tm, and returns
+		// the batch size for measuring (filling the warmup fields of st)
+		template<class Batch>
+		inline size_t warm_up_bench(const benchmark_option& option, Batch& batch, bench_stats& st)
+		{
+			timer tw(true);
+			timer tm;
+
+			// warming
+
+			if (option.warming_runs > 0) batch(option.warming_runs, tm);
+
+			// probing
+
+			size_t bsiz = option.probe_batch_size;
+			double pt = batch(bsiz, tm);
+
+			st.warmup_runs = option.warming_runs + bsiz;
+
+			// determine batch size
+
+			bsiz = determine_bench_batch_size(option, pt);
+
+			// warming until steady
+
+			const size_t w = option.warming_window;
+			st.warmup_steady = (w == 0);
+
+			if (w > 0)
+			{
+				std::vector<double> wt;
+				wt.reserve(w);
+
+				while (tw.elapsed_secs() < option.max_warming_time)
+				{
+					double t = batch(bsiz, tm);
+					st.warmup_runs += bsiz;
+
+					if (wt.size() == w) wt.erase(wt.begin());
+					wt.push_back(t);
+
+					if (wt.size() == w && is_steady(&wt[0], w, option.warming_tol))
+					{
+						st.warmup_steady = true;
+						break;
+					}
+				}
+			}
+			st.warmup_secs = tw.elapsed_secs();
+
+			return bsiz;
+		}
+
+		// runs batches under the warmup and stopping rules of the option,
+		// and reports them as runs of job
+		template<class Job, class Monitor, class Batch>
+		inline void run_bench_batches(const Job& job, Monitor& mon,
+				const benchmark_option& option, Batch batch)
+		{
+			numa_scope placement(option.cpu_node, option.mem_node);
+			bench_stats st;
+			const size_t bsiz = warm_up_bench(option, batch, st);
+			timer tm;
+
+			// measuring
+
+			double et = 0.0;
+			size_t k = 0;
+			batch_stats stats;
+
+			if (option.profiler) option.profiler->start();
+
+			for(;;)
+			{
+				double t = batch(bsiz, tm);
+
+				et += t;
+				++k;
+				stats.add(t);
+
+				if (et >= option.time_thres) break;
+
+				if (option.rel_ci > 0 && et >= option.min_time && k >= option.min_batches &&
+					stats.rel_ci() <= option.rel_ci) break;
+			}
+
+			if (option.profiler) option.profiler->stop();
+
+			st.num_batches = k;
+			st.rel_ci = stats.rel_ci();
+
+			report_with(mon, job, k * bsiz, runtime_span::from_secs(et), st, 0);
+		}
+	}
+
+
 	template<class Job, class Monitor>
 	inline void run_benchmark(const Job& job, Monitor& mon,
 			const benchmark_option& option)
 	{
-		// warming
-
-		for (size_t i = 0; i < option.warming_runs; ++i) job();
+		detail::run_bench_batches(job, mon, option, [&](size_t n, timer& tm)
+		{
+			tm.start();
+			for (size_t i = 0; i < n; ++i) job();
+			return tm.elapsed_secs();
+		});
+	}
 
-		// probing
 
-		size_t bsiz = option.probe_batch_size;
-		timer tm0(true);
-		for (size_t i = 0; i < bsiz; ++i) job();
-		double pt = tm0.elapsed_secs();
+	/**
+	 * Benchmarks a fixture, i.e. a job with state to be prepared outside
+	 * of the timed region. Besides name() and size() (and the optional
+	 * declarations of roofline.h), a fixture has
+	 *
+	 *   void set_up();         // before each batch, not timed
+	 *   void run(timer& tm);   // a call
+	 *   void tear_down();      // after each batch, not timed
+	 *
+	 * where run may exclude the preparation of each call by enclosing
+	 * it in tm.pause() and tm.resume(). The batches are run as with
+	 * run_benchmark.
+	 */
+	template<class Fixture, class Monitor>
+	inline void run_fixture_benchmark(Fixture& fx, Monitor& mon,
+			const benchmark_option& option)
+	{
+		detail::run_bench_batches(fx, mon, option, [&](size_t n, timer& tm)
+		{
+			fx.set_up();
+			tm.start();
+			for (size_t i = 0; i < n; ++i) fx.run(tm);
+			double t = tm.elapsed_secs();
+			fx.tear_down();
+			return t;
+		});
+	}
 
-		// determine batch size
 
-		bsiz = determine_bench_batch_size(option, pt);
+	/**
+	 * Times every call of the job separately (with cycle_clock, less
+	 * the cost of reading it), until time_thres seconds are spent in
+	 * the calls, or 4 * time_thres seconds of wall time have passed
+	 * (calls quicker than the clock overhead count as zero). The
+	 * latencies are recorded into a histogram, which is passed to the
+	 * monitor after the count and the total time. The job is warmed up
+	 * before, as for run_benchmark.
+	 */
+	template<class Job, class Monitor>
+	inline void run_latency_benchmark(const Job& job, Monitor& mon,
+			const benchmark_option& option)
+	{
+		typedef cycle_clock::tick_type tick_t;
+		numa_scope placement(option.cpu_node, option.mem_node);
 
-		timer tm;
-		double et = 0.0;
-		double tt = option.time_thres;
-		size_t k = 0;
+		// warming (as for run_benchmark)
 
-		while (et < tt)
+		auto batch = [&](size_t n, timer& tm)
 		{
 			tm.start();
-			for (size_t i = 0; i < bsiz; ++i) job();
-			et += tm.elapsed_secs();
-			++k;
+			for (size_t i = 0; i < n; ++i) job();
+			return tm.elapsed_secs();
+		};
+		bench_stats st;
+		detail::warm_up_bench(option, batch, st);
+
+		const double tpn = cycle_clock::nsecs_per_tick();
+		const tick_t ovh = cycle_clock::overhead();
+		const tick_t limit = (tick_t)(option.time_thres * 1.0e9 / tpn);
+
+		latency_histogram hist(tpn);
+		tick_t total = 0;
+		size_t n = 0;
+
+		timer tw(true);
+		const double wall_limit = 4.0 * option.time_thres;
+
+		while (total < limit && tw.elapsed_secs() < wall_limit)
+		{
+			tick_t t0 = cycle_clock::begin();
+			job();
+			tick_t t1 = cycle_clock::end();
+
+			tick_t d = t1 - t0;
+			d = d > ovh ? d - ovh : 0;
+
+			hist.add(d);
+			total += d;
+			++n;
 		}
 
-		mon(job, k * bsiz, runtime_span::from_secs(et));
+		mon(job, n, runtime_span::from_nsecs((double)total * tpn), hist);
 	}
 
 }
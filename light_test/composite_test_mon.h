@@ -0,0 +1,229 @@
+/**
+ * @file composite_test_mon.h
+ *
+ * Monitors that forward testing events to multiple monitors
+ *
+ * @author Dahua Lin
+ */
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#ifndef LIGHT_TEST_COMPOSITE_TEST_MON_H_
+#define LIGHT_TEST_COMPOSITE_TEST_MON_H_
+
+#include "test_mon.h"
+#include <vector>
+
+namespace ltest
+{
+
+	/**
+	 * A monitor that forwards each event to a list of monitors
+	 * attached at runtime (in the order they were added).
+	 *
+	 * The attached monitors are not owned.
+	 */
+	class composite_test_monitor : public test_monitor
+	{
+	public:
+		composite_test_monitor() { }
+
+		composite_test_monitor& add(test_monitor& mon)
+		{
+			m_mons.push_back(&mon);
+			return *this;
+		}
+
+		size_t size() const
+		{
+			return m_mons.size();
+		}
+
+	public:
+		virtual void on_suite_begin(const test_suite& tsuite)
+		{
+			for (size_t i = 0; i < m_mons.size(); ++i) m_mons[i]->on_suite_begin(tsuite);
+		}
+
+		virtual void on_suite_end(const test_suite& tsuite, size_t nfinished_cases, size_t npassed_cases)
+		{
+			for (size_t i = 0; i < m_mons.size(); ++i) m_mons[i]->on_suite_end(tsuite, nfinished_cases, npassed_cases);
+		}
+
+		virtual void on_pack_selection(const test_pack& tpack, size_t ncases)
+		{
+			for (size_t i = 0; i < m_mons.size(); ++i) m_mons[i]->on_pack_selection(tpack, ncases);
+		}
+
+		virtual void on_pack_begin(const test_pack& tpack)
+		{
+			for (size_t i = 0; i < m_mons.size(); ++i) m_mons[i]->on_pack_begin(tpack);
+		}
+
+		virtual void on_pack_end(const test_pack& tpack, size_t npassed_cases)
+		{
+			for (size_t i = 0; i < m_mons.size(); ++i) m_mons[i]->on_pack_end(tpack, npassed_cases);
+		}
+
+		virtual void on_case_begin(const test_case& tcase)
+		{
+			for (size_t i = 0; i < m_mons.size(); ++i) m_mons[i]->on_case_begin(tcase);
+		}
+
+		virtual void on_case_end(const test_case& tcase, bool is_passed)
+		{
+			for (size_t i = 0; i < m_mons.size(); ++i) m_mons[i]->on_case_end(tcase, is_passed);
+		}
+
+		virtual void on_assertion_failure(const assertion_failure& e)
+		{
+			for (size_t i = 0; i < m_mons.size(); ++i) m_mons[i]->on_assertion_failure(e);
+		}
+
+		virtual void on_exception(const std::exception& e)
+		{
+			for (size_t i = 0; i < m_mons.size(); ++i) m_mons[i]->on_exception(e);
+		}
+
+		virtual void on_expectation_failures(const expectation_log& log)
+		{
+			for (size_t i = 0; i < m_mons.size(); ++i) m_mons[i]->on_expectation_failures(log);
+		}
+
+	private:
+		composite_test_monitor(const composite_test_monitor& );
+		composite_test_monitor& operator = (const composite_test_monitor& );
+
+	private:
+		std::vector<test_monitor*> m_mons;
+
+	}; // end class composite_test_monitor
+
+
+	/**
+	 * A monitor that forwards each event to a fixed set of monitors
+	 * whose types are known at compile time.
+	 *
+	 * It is not a test_monitor itself: when passed to execute_suite (or
+	 * execute_pack/execute_case), all callbacks are resolved statically.
+	 * Each callback of a monitor of type M is called as M::on_xxx, so
+	 * the types given here should be the actual types of the monitors.
+	 *
+	 * The monitors are held by reference, so the composite can be passed
+	 * to execute_suite as a temporary, e.g.
+	 *
+	 *   execute_suite(suite, make_static_composite(junit_mon, tap_mon));
+	 */
+	template<class... Monitors>
+	class static_composite_monitor;
+
+	template<>
+	class static_composite_monitor<>
+	{
+	public:
+		void on_suite_begin(const test_suite& ) { }
+
+		void on_suite_end(const test_suite& , size_t , size_t ) { }
+
+		void on_pack_selection(const test_pack& , size_t ) { }
+
+		void on_pack_begin(const test_pack& ) { }
+
+		void on_pack_end(const test_pack& , size_t ) { }
+
+		void on_case_begin(const test_case& ) { }
+
+		void on_case_end(const test_case& , bool ) { }
+
+		void on_assertion_failure(const assertion_failure& ) { }
+
+		void on_exception(const std::exception& ) { }
+
+		void on_expectation_failures(const expectation_log& ) { }
+	};
+
+	template<class M, class... Rest>
+	class static_composite_monitor<M, Rest...> : public static_composite_monitor<Rest...>
+	{
+		typedef static_composite_monitor<Rest...> tail_t;
+
+	public:
+		explicit static_composite_monitor(M& head, Rest&... rest)
+		: tail_t(rest...), m_head(head) { }
+
+		void on_suite_begin(const test_suite& tsuite)
+		{
+			m_head.M::on_suite_begin(tsuite);
+			tail_t::on_suite_begin(tsuite);
+		}
+
+		void on_suite_end(const test_suite& tsuite, size_t nfinished_cases, size_t npassed_cases)
+		{
+			m_head.M::on_suite_end(tsuite, nfinished_cases, npassed_cases);
+			tail_t::on_suite_end(tsuite, nfinished_cases, npassed_cases);
+		}
+
+		void on_pack_selection(const test_pack& tpack, size_t ncases)
+		{
+			m_head.M::on_pack_selection(tpack, ncases);
+			tail_t::on_pack_selection(tpack, ncases);
+		}
+
+		void on_pack_begin(const test_pack& tpack)
+		{
+			m_head.M::on_pack_begin(tpack);
+			tail_t::on_pack_begin(tpack);
+		}
+
+		void on_pack_end(const test_pack& tpack, size_t npassed_cases)
+		{
+			m_head.M::on_pack_end(tpack, npassed_cases);
+			tail_t::on_pack_end(tpack, npassed_cases);
+		}
+
+		void on_case_begin(const test_case& tcase)
+		{
+			m_head.M::on_case_begin(tcase);
+			tail_t::on_case_begin(tcase);
+		}
+
+		void on_case_end(const test_case& tcase, bool is_passed)
+		{
+			m_head.M::on_case_end(tcase, is_passed);
+			tail_t::on_case_end(tcase, is_passed);
+		}
+
+		void on_assertion_failure(const assertion_failure& e)
+		{
+			m_head.M::on_assertion_failure(e);
+			tail_t::on_assertion_failure(e);
+		}
+
+		void on_exception(const std::exception& e)
+		{
+			m_head.M::on_exception(e);
+			tail_t::on_exception(e);
+		}
+
+		void on_expectation_failures(const expectation_log& log)
+		{
+			m_head.M::on_expectation_failures(log);
+			tail_t::on_expectation_failures(log);
+		}
+
+	private:
+		M& m_head;
+	};
+
+
+	template<class... Monitors>
+	inline static_composite_monitor<Monitors...> make_static_composite(Monitors&... mons)
+	{
+		return static_composite_monitor<Monitors...>(mons...);
+	}
+
+}
+
+#endif /* COMPOSITE_TEST_MON_H_ */
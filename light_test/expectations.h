@@ -0,0 +1,251 @@
+/**
+ * @file expectations.h
+ *
+ * Soft assertions (EXPECT_*), which record a failure and let the
+ * test case continue
+ *
+ * The failures are recorded in a thread-local log of fixed capacity,
+ * which is cleared when a case begins. When the case ends, a non-empty
+ * log marks the case as failed and is passed to the monitor through
+ * on_expectation_failures. Failures in the set_up or tear_down of a pack
+ * or suite fixture are passed on in the same way, when that call returns
+ * (outside of any case).
+ *
+ * A failure records its location, the (literal) expression text and,
+ * for comparisons of numbers or strings, the values of the operands.
+ * The operands are evaluated once, and a passing check allocates no
+ * memory.
+ *
+ * @author Dahua Lin
+ */
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#ifndef LIGHT_TEST_EXPECTATIONS_H_
+#define LIGHT_TEST_EXPECTATIONS_H_
+
+#include "test_assertions.h"
+#include "str_template.h"
+
+// the maximum number of failures whose details are kept for a case
+#ifndef LTEST_EXPECTATION_LOG_SIZE
+#define LTEST_EXPECTATION_LOG_SIZE 16
+#endif
+
+// the room for the operand values of a failure (longer ones are cut)
+#ifndef LTEST_EXPECTATION_VALUES_SIZE
+#define LTEST_EXPECTATION_VALUES_SIZE 128
+#endif
+
+namespace ltest
+{
+	struct expectation_failure_info
+	{
+		const char *file;
+		unsigned int line;
+		const char *expr;
+		char values[LTEST_EXPECTATION_VALUES_SIZE];	// e.g. "3 vs 4" (empty if not shown)
+	};
+
+
+	struct expectation_log
+	{
+		static const size_t capacity = LTEST_EXPECTATION_LOG_SIZE;
+
+		size_t count;	// the number of failures (may exceed capacity)
+		expectation_failure_info records[capacity];
+
+		bool empty() const
+		{
+			return count == 0;
+		}
+
+		size_t num_records() const
+		{
+			return count < capacity ? count : (size_t)capacity;
+		}
+
+		void clear()
+		{
+			count = 0;
+		}
+
+		void add(const char *file, unsigned int line, const char *expr, const char *values = "")
+		{
+			if (count < capacity)
+			{
+				expectation_failure_info& r = records[count];
+				r.file = file;
+				r.line = line;
+				r.expr = expr;
+				std::strncpy(r.values, values, sizeof(r.values) - 1);
+				r.values[sizeof(r.values) - 1] = '\0';
+			}
+			++ count;
+		}
+
+		std::string str() const
+		{
+			std::string s = sformat(count, "%lu expectation(s) failed:");
+			for (size_t i = 0; i < num_records(); ++i)
+			{
+				s += "\n  ";
+				s += records[i].file;
+				s += sformat(records[i].line, " (%u): ");
+				s += records[i].expr;
+				if (records[i].values[0])
+				{
+					s += " (";
+					s += records[i].values;
+					s += ")";
+				}
+			}
+			if (count > capacity)
+			{
+				s += sformat(count - capacity, "\n  ... (%lu more)");
+			}
+			return s;
+		}
+	};
+
+
+	// the log of the case running on the calling thread
+	inline expectation_log& current_expectations()
+	{
+		static LTEST_THREAD_LOCAL expectation_log s_log;
+		return s_log;
+	}
+
+	LTEST_NOINLINE inline void expectation_failed(const char *file, unsigned int line, const char *expr)
+	{
+		current_expectations().add(file, line, expr);
+	}
+
+
+	namespace detail
+	{
+		// the text of an operand value: numbers and strings are shown,
+		// other values are not (an empty text)
+
+		template<typename T>
+		inline std::string expect_value_str(const T& v)
+		{
+			typedef mismatch_value<T> mv;
+			return mv::is_numeric ? mv::str(v) : std::string();
+		}
+
+		inline std::string expect_value_str(const char *s)
+		{
+			return s ? std::string("\"") + s + "\"" : std::string("(null)");
+		}
+
+		inline std::string expect_value_str(char *s)
+		{
+			return expect_value_str((const char*)s);
+		}
+
+		inline std::string expect_value_str(const std::string& s)
+		{
+			return expect_value_str(s.c_str());
+		}
+
+		template<typename A, typename B>
+		LTEST_NOINLINE void expectation_failed(const char *file, unsigned int line, const char *expr,
+				const A& a, const B& b)
+		{
+			std::string sa = expect_value_str(a);
+			std::string sb = expect_value_str(b);
+			std::string v = sa.empty() || sb.empty() ? std::string() : sa + " vs " + sb;
+			current_expectations().add(file, line, expr, v.c_str());
+		}
+
+		// the checks of the macros, which evaluate each operand once
+
+		template<typename A, typename B>
+		inline void expect_eq(const A& a, const B& b, const char *file, unsigned int line, const char *expr)
+		{
+			if (!(a == b)) expectation_failed(file, line, expr, a, b);
+		}
+
+		template<typename A, typename B>
+		inline void expect_ne(const A& a, const B& b, const char *file, unsigned int line, const char *expr)
+		{
+			if (!(a != b)) expectation_failed(file, line, expr, a, b);
+		}
+
+		template<typename A, typename B, typename Tol>
+		inline void expect_approx(const A& a, const B& b, const Tol& tol,
+				const char *file, unsigned int line, const char *expr)
+		{
+			if (!test_approx(a, b, tol)) expectation_failed(file, line, expr, a, b);
+		}
+
+		template<typename A, typename B, typename D>
+		inline void expect_ulp(const A& a, const B& b, const D& dtol,
+				const char *file, unsigned int line, const char *expr)
+		{
+			if (!(ulp_distance(a, b) <= static_cast<unsigned int>(dtol))) expectation_failed(file, line, expr, a, b);
+		}
+
+		template<typename A, typename B>
+		inline void expect_streq(const A& a, const B& b, const char *file, unsigned int line, const char *expr)
+		{
+			if (!(std::string(a) == std::string(b))) expectation_failed(file, line, expr, a, b);
+		}
+	}
+
+}
+
+/************************************************
+ *
+ *  Macros
+ *
+ ************************************************/
+
+#define LTEST_EXPECT_( cond, text ) \
+	if (!(cond)) ::ltest::expectation_failed(__FILE__, __LINE__, text)
+
+#define EXPECT_TRUE( cond ) LTEST_EXPECT_( cond, #cond " is TRUE" )
+
+#define EXPECT_FALSE( cond ) LTEST_EXPECT_( !(cond), #cond " is FALSE" )
+
+#define EXPECT_EQ( a, b ) ::ltest::detail::expect_eq(a, b, __FILE__, __LINE__, #a " == " #b)
+
+#define EXPECT_NE( a, b ) ::ltest::detail::expect_ne(a, b, __FILE__, __LINE__, #a " != " #b)
+
+// with a plain number as tol, the test is |a - b| <= tol (as ASSERT_APPROX)
+#define EXPECT_APPROX( a, b, tol ) ::ltest::detail::expect_approx(a, b, tol, __FILE__, __LINE__, #a " ~= " #b)
+
+#define EXPECT_APPROX_REL( a, b, rtol ) \
+	::ltest::detail::expect_approx(a, b, ::ltest::rel_tol(rtol), __FILE__, __LINE__, \
+			#a " ~= " #b " (rel tol = " #rtol ")")
+
+#define EXPECT_ULP( a, b, dtol ) \
+	::ltest::detail::expect_ulp(a, b, dtol, __FILE__, __LINE__, "ULP(" #a ", " #b ") <= " #dtol)
+
+#define EXPECT_VEC_ULP( n, a, b, dtol ) \
+	LTEST_EXPECT_( ::ltest::max_ulp_diff(n, a, b) <= (dtol), "ULP(" #a "[0:" #n "], " #b "[0:" #n "]) <= " #dtol )
+
+#define EXPECT_STREQ( a, b ) ::ltest::detail::expect_streq(a, b, __FILE__, __LINE__, #a " == " #b)
+
+#define EXPECT_VEC_EQ( n, a, b ) \
+	LTEST_EXPECT_( ::ltest::test_vector_equal(n, a, b), #a "[0:" #n "] == " #b "[0:" #n "]" )
+
+#define EXPECT_VEC_EQS( n, a, v ) \
+	LTEST_EXPECT_( ::ltest::test_vector_equals(n, a, v), #a "[0:" #n "] == " #v )
+
+#define EXPECT_VEC_APPROX( n, a, b, tol ) \
+	LTEST_EXPECT_( ::ltest::test_vector_approx(n, a, b, tol), #a "[0:" #n "] ~= " #b "[0:" #n "]" )
+
+#define EXPECT_MAT_EQ( m, n, a, b ) \
+	LTEST_EXPECT_( ::ltest::test_matrix_equal(m, n, a, b), #a "[0:" #m ", 0:" #n "] == " #b "[0:" #m ", 0:" #n "]" )
+
+#define EXPECT_MAT_EQS( m, n, a, v ) \
+	LTEST_EXPECT_( ::ltest::test_matrix_equals(m, n, a, v), #a "[0:" #m ", 0:" #n "] == " #v )
+
+#define EXPECT_MAT_APPROX( m, n, a, b, tol ) \
+	LTEST_EXPECT_( ::ltest::test_matrix_approx(m, n, a, b, tol), #a "[0:" #m ", 0:" #n "] ~= " #b "[0:" #m ", 0:" #n "]" )
+
+#endif /* EXPECTATIONS_H_ */
@@ -24,6 +24,8 @@
 #include <stdexcept>
 #include <cmath>
 
+#include "internal/ulp_kernels.h"
+
 namespace ltest
 {
 #ifdef LTEST_USE_C11_STDLIB
@@ -98,6 +100,18 @@ namespace ltest
 			return d;
 		}
 
+#if defined(__GNUC__)
+		inline unsigned int ulp_int(uint32_t a)
+		{
+			return a ? (unsigned int)(32 - __builtin_clz(a)) : 0u;
+		}
+
+		inline unsigned int ulp_int(uint64_t a)
+		{
+			return a ? (unsigned int)(64 - __builtin_clzll(a)) : 0u;
+		}
+#endif
+
 		template<typename T>
 		inline unsigned int ulp_distance_p(const T& a, const T& b)  // apply when 0 <= a < b < inf
 		{
@@ -169,6 +183,124 @@ namespace ltest
 		}
 	}
 
+
+	/************************************************
+	 *
+	 *  ULP distances over arrays
+	 *
+	 *  Unlike ulp_distance, which returns the number of bits
+	 *  of the difference, these give the number of representable
+	 *  values between a and b (so ulp_distance is approximately
+	 *  detail::ulp_int(ulp_diff)). Infinities are accepted (the
+	 *  largest finite value is 1 ULP from infinity), two NaNs are
+	 *  0 ULP apart and NaN is at the maximum distance from any
+	 *  other value.
+	 *
+	 ************************************************/
+
+	inline uint32_t ulp_diff(float a, float b)
+	{
+		return internal::ulp_diff_scalar(a, b);
+	}
+
+	inline uint64_t ulp_diff(double a, double b)
+	{
+		return internal::ulp_diff_scalar(a, b);
+	}
+
+	inline void ulp_diffs(size_t n, const float *a, const float *b, uint32_t *out)
+	{
+		internal::ulp_diffs_scalar(n, a, b, out);
+	}
+
+	inline void ulp_diffs(size_t n, const double *a, const double *b, uint64_t *out)
+	{
+		internal::ulp_diffs_scalar(n, a, b, out);
+	}
+
+	inline uint32_t max_ulp_diff(size_t n, const float *a, const float *b)
+	{
+		return internal::max_ulp_diff(n, a, b);
+	}
+
+	inline uint64_t max_ulp_diff(size_t n, const double *a, const double *b)
+	{
+		return internal::max_ulp_diff(n, a, b);
+	}
+
+
+	/**
+	 * Histogram of ULP distances on a logarithmic scale.
+	 *
+	 * Bin 0 counts exact matches, bin k (k >= 1) counts distances d
+	 * with 2^(k-1) <= d < 2^k.
+	 */
+	class ulp_histogram
+	{
+	public:
+		static const unsigned int nbins = 65;
+
+		ulp_histogram()
+		{
+			clear();
+		}
+
+		void clear()
+		{
+			for (unsigned int k = 0; k < nbins; ++k) m_counts[k] = 0;
+			m_total = 0;
+		}
+
+		void add(uint64_t d)
+		{
+			++ m_counts[detail::ulp_int(d)];
+			++ m_total;
+		}
+
+		template<typename T>
+		void add(size_t n, const T *a, const T *b)
+		{
+			const size_t bsiz = 1024;
+			typename internal::ulp_repr<T>::uint_t buf[bsiz];
+
+			for (size_t i = 0; i < n; i += bsiz)
+			{
+				size_t m = n - i < bsiz ? n - i : bsiz;
+				ulp_diffs(m, a + i, b + i, buf);
+				for (size_t j = 0; j < m; ++j) ++ m_counts[detail::ulp_int(buf[j])];
+			}
+			m_total += n;
+		}
+
+		void merge(const ulp_histogram& other)
+		{
+			for (unsigned int k = 0; k < nbins; ++k) m_counts[k] += other.m_counts[k];
+			m_total += other.m_total;
+		}
+
+		uint64_t count(unsigned int k) const
+		{
+			return m_counts[k];
+		}
+
+		uint64_t total() const
+		{
+			return m_total;
+		}
+
+		// the highest non-empty bin (0 if empty)
+		unsigned int max_bin() const
+		{
+			unsigned int k = nbins;
+			while (k > 1 && m_counts[k-1] == 0) --k;
+			return k - 1;
+		}
+
+	private:
+		uint64_t m_counts[nbins];
+		uint64_t m_total;
+	};
+
 }
 
 #endif
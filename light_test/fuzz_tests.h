@@ -0,0 +1,413 @@
+/**
+ * @file fuzz_tests.h
+ *
+ * Fuzz targets that also run as regular test cases
+ *
+ * A fuzz target is a function
+ *
+ *   void f(const uint8_t *data, size_t size);
+ *
+ * which reports failures by throwing (e.g. via the ASSERT_* macros).
+ * A target registered with ADD_FUZZ_TEST becomes a test case that
+ * replays every file of a corpus directory (e.g. the inputs found by
+ * a fuzzer) through the target; a missing or empty corpus fails the
+ * case. The files are memory-mapped, and are replayed in parallel by a
+ * pool of threads. The reported failure is the one of the first failing
+ * file (in name order), regardless of the number of threads.
+ *
+ * When LTEST_LIBFUZZER is defined (in the translation unit that would
+ * contain main, which must then be excluded), this header provides the
+ * libFuzzer entry point, so that the same sources can be built with
+ * -fsanitize=fuzzer. The target is chosen by the environment variable
+ * LTEST_FUZZ_TARGET, which can be omitted if only one target is
+ * registered. A failure is printed and turned into an abort, which is
+ * what libFuzzer records as a crash.
+ *
+ * @author Dahua Lin
+ */
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#ifndef LIGHT_TEST_FUZZ_TESTS_H_
+#define LIGHT_TEST_FUZZ_TESTS_H_
+
+#include "test_assertions.h"
+#include "expectations.h"
+#include "test_units.h"
+#include "str_template.h"
+
+#ifdef LTEST_USE_C11_STDLIB
+#include <cstdint>
+#else
+#include <stdint.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#if (defined(_WIN32) || defined(_WIN64))
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#define NOGDI
+#include <windows.h>
+#undef WIN32_LEAN_AND_MEAN
+#undef NOMINMAX
+#undef NOGDI
+#include <fstream>
+#else
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace ltest
+{
+#ifdef LTEST_USE_C11_STDLIB
+	using std::uint8_t;
+#else
+	using ::uint8_t;
+#endif
+
+	typedef void (*fuzz_func_t)(const uint8_t *data, size_t size);
+
+	/**
+	 * The name, corpus and file strings are not copied, and should
+	 * be static (as given by ADD_FUZZ_TEST).
+	 */
+	struct fuzz_target
+	{
+		const char *name;
+		fuzz_func_t func;
+		const char *corpus;		// the corpus directory
+		const char *file;
+		unsigned int line;
+	};
+
+	// all targets registered by ADD_FUZZ_TEST
+	inline std::vector<fuzz_target>& fuzz_targets()
+	{
+		static std::vector<fuzz_target> targets;
+		return targets;
+	}
+
+	inline const fuzz_target* find_fuzz_target(const char *name)
+	{
+		const std::vector<fuzz_target>& ts = fuzz_targets();
+		for (size_t i = 0; i < ts.size(); ++i)
+		{
+			if (std::strcmp(ts[i].name, name) == 0) return &ts[i];
+		}
+		return 0;
+	}
+
+
+	namespace detail
+	{
+		/**
+		 * The read-only contents of a file, mapped into memory
+		 * (or read into a buffer where mapping is not available)
+		 */
+		class mapped_input
+		{
+		public:
+			explicit mapped_input(const std::string& path)
+			: m_data(0), m_size(0)
+			{
+#if (defined(_WIN32) || defined(_WIN64))
+				std::ifstream in(path.c_str(), std::ios::binary);
+				if (!in) throw std::runtime_error("Failed to open the input " + path);
+				m_buf.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+				m_data = m_buf.empty() ? 0 : reinterpret_cast<const uint8_t*>(&m_buf[0]);
+				m_size = m_buf.size();
+#else
+				int fd = ::open(path.c_str(), O_RDONLY);
+				if (fd < 0) throw std::runtime_error("Failed to open the input " + path);
+
+				struct stat st;
+				if (::fstat(fd, &st) != 0)
+				{
+					::close(fd);
+					throw std::runtime_error("Failed to stat the input " + path);
+				}
+
+				if (st.st_size > 0)
+				{
+					void *p = ::mmap(0, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+					if (p != MAP_FAILED)
+					{
+						m_data = static_cast<const uint8_t*>(p);
+						m_size = (size_t)st.st_size;
+					}
+				}
+				::close(fd);
+
+				if (st.st_size > 0 && !m_data) throw std::runtime_error("Failed to map the input " + path);
+#endif
+			}
+
+			~mapped_input()
+			{
+#if !(defined(_WIN32) || defined(_WIN64))
+				if (m_data) ::munmap(const_cast<uint8_t*>(m_data), m_size);
+#endif
+			}
+
+			const uint8_t *data() const
+			{
+				return m_data;
+			}
+
+			size_t size() const
+			{
+				return m_size;
+			}
+
+		private:
+			mapped_input(const mapped_input& );
+			mapped_input& operator = (const mapped_input& );
+
+			const uint8_t *m_data;
+			size_t m_size;
+#if (defined(_WIN32) || defined(_WIN64))
+			std::vector<char> m_buf;
+#endif
+		};
+
+		// the paths of the regular files in dir, sorted by name
+		inline std::vector<std::string> list_corpus(const std::string& dir)
+		{
+			std::vector<std::string> paths;
+#if (defined(_WIN32) || defined(_WIN64))
+			WIN32_FIND_DATAA fd;
+			HANDLE h = ::FindFirstFileA((dir + "\\*").c_str(), &fd);
+			if (h == INVALID_HANDLE_VALUE) throw std::runtime_error("Failed to open the corpus directory " + dir);
+			do
+			{
+				if (!(fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) paths.push_back(dir + "\\" + fd.cFileName);
+			}
+			while (::FindNextFileA(h, &fd));
+			::FindClose(h);
+#else
+			DIR *d = ::opendir(dir.c_str());
+			if (!d) throw std::runtime_error("Failed to open the corpus directory " + dir);
+
+			struct dirent *e;
+			while ((e = ::readdir(d)) != 0)
+			{
+				std::string path = dir + "/" + e->d_name;
+				struct stat st;
+				if (::stat(path.c_str(), &st) == 0 && S_ISREG(st.st_mode)) paths.push_back(path);
+			}
+			::closedir(d);
+#endif
+			std::sort(paths.begin(), paths.end());
+			return paths;
+		}
+
+		// runs an input through a target, returns false (with
+		// a message) if it fails, by throwing or by EXPECT_*
+		inline bool run_fuzz_input(fuzz_func_t f, const uint8_t *data, size_t size, std::string *msg)
+		{
+			expectation_log& elog = current_expectations();
+			elog.clear();
+			try
+			{
+				f(data, size);
+				if (elog.empty()) return true;
+				*msg = elog.str();
+				elog.clear();
+				return false;
+			}
+			catch (assertion_failure& e)
+			{
+				*msg = e.what();
+			}
+			catch (std::exception& e)
+			{
+				*msg = std::string("STD Exception: ") + (e.what() != 0 ? e.what() : "Unknown cause");
+			}
+			catch (...)
+			{
+				*msg = "Unknown exception";
+			}
+			elog.clear();
+			return false;
+		}
+	}
+
+
+	/**
+	 * Replays the corpus of a fuzz target
+	 */
+	class fuzz_replay_case : public test_case
+	{
+	public:
+		explicit fuzz_replay_case(const fuzz_target& t)
+		: m_target(t), m_nthreads(0)
+		{
+		}
+
+		virtual const char *name() const
+		{
+			return m_target.name;
+		}
+
+		// 0: use all hardware threads
+		void set_num_threads(unsigned int n)
+		{
+			m_nthreads = n;
+		}
+
+		virtual void run()
+		{
+			const std::vector<std::string> paths = detail::list_corpus(m_target.corpus);
+			const size_t n = paths.size();
+			if (n == 0)
+			{
+				// an empty corpus replays nothing, which is most likely a wrong path
+				throw assertion_failure(m_target.file, m_target.line, m_target.name,
+						std::string("      no inputs in the corpus ") + m_target.corpus);
+			}
+
+			unsigned int nthreads = m_nthreads ? m_nthreads : std::thread::hardware_concurrency();
+			if (nthreads == 0) nthreads = 1;
+			if (nthreads > n) nthreads = (unsigned int)n;
+
+			std::atomic<size_t> next_input(0);
+			std::atomic<size_t> first_failure(n);
+			std::mutex mtx;
+			std::string fail_msg;
+			size_t fail_size = 0;
+
+			auto worker = [&]()
+			{
+				size_t i;
+				while ((i = next_input++) < n && i < first_failure.load())
+				{
+					std::string msg;
+					size_t size = 0;
+					bool ok;
+					try
+					{
+						detail::mapped_input in(paths[i]);
+						size = in.size();
+						ok = detail::run_fuzz_input(m_target.func, in.data(), size, &msg);
+					}
+					catch (std::exception& e)
+					{
+						msg = e.what();
+						ok = false;
+					}
+
+					if (!ok)
+					{
+						std::lock_guard<std::mutex> lock(mtx);
+						if (i < first_failure.load())
+						{
+							first_failure = i;
+							fail_msg = msg;
+							fail_size = size;
+						}
+					}
+				}
+			};
+
+			std::vector<std::thread> threads;
+			for (unsigned int t = 1; t < nthreads; ++t) threads.push_back(std::thread(worker));
+			worker();
+			for (size_t t = 0; t < threads.size(); ++t) threads[t].join();
+
+			size_t i = first_failure.load();
+			if (i == n) return;
+
+			std::string detail = "      failed on " + paths[i];
+			detail += sformat(fail_size, " (%lu bytes, ");
+			detail += sformat(i + 1, "input %lu") + sformat(n, " of %lu)");
+			detail += "\n      " + fail_msg;
+
+			throw assertion_failure(m_target.file, m_target.line, m_target.name, detail);
+		}
+
+	private:
+		fuzz_target m_target;
+		unsigned int m_nthreads;
+
+	}; // end class fuzz_replay_case
+
+
+	inline test_case* register_fuzz_target(const char *name, fuzz_func_t func, const char *corpus,
+			const char *file, unsigned int line)
+	{
+		fuzz_target t = { name, func, corpus, file, line };
+		fuzz_targets().push_back(t);
+		return new fuzz_replay_case(t);
+	}
+
+
+	namespace detail
+	{
+		inline const fuzz_target& selected_fuzz_target()
+		{
+			const char *name = std::getenv("LTEST_FUZZ_TARGET");
+			const fuzz_target *t = 0;
+
+			if (name && *name)
+				t = find_fuzz_target(name);
+			else if (fuzz_targets().size() == 1)
+				t = &fuzz_targets()[0];
+
+			if (!t)
+			{
+				std::fprintf(stderr, "Set LTEST_FUZZ_TARGET to one of the fuzz targets:\n");
+				for (size_t i = 0; i < fuzz_targets().size(); ++i)
+				{
+					std::fprintf(stderr, "  %s\n", fuzz_targets()[i].name);
+				}
+				std::abort();
+			}
+			return *t;
+		}
+	}
+
+}
+
+
+#ifdef LTEST_LIBFUZZER
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+	static const ltest::fuzz_target& t = ltest::detail::selected_fuzz_target();
+
+	std::string msg;
+	if (!ltest::detail::run_fuzz_input(t.func, data, size, &msg))
+	{
+		std::fprintf(stderr, "%s: %s\n", t.name, msg.c_str());
+		std::abort();
+	}
+	return 0;
+}
+
+#endif
+
+
+// to be used within AUTO_TPACK, e.g.
+//
+//   ADD_FUZZ_TEST( fuzz_parse_header, "corpus/parse_header" )
+//
+// where the corpus path is relative to the working directory
+
+#define ADD_FUZZ_TEST( Func, Corpus ) \
+	this->add(::ltest::register_fuzz_target(#Func, &Func, Corpus, __FILE__, __LINE__));
+
+#endif /* FUZZ_TESTS_H_ */
@@ -0,0 +1,122 @@
+/**
+ * @file case_record.h
+ *
+ * @brief Per-thread records of running test cases (used by report monitors)
+ *
+ * @author Dahua Lin
+ */
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#ifndef LIGHT_TEST_CASE_RECORD_H_
+#define LIGHT_TEST_CASE_RECORD_H_
+
+#include "../test_assertions.h"
+#include "../expectations.h"
+#include "../timer.h"
+
+#include <map>
+#include <mutex>
+#include <thread>
+
+namespace ltest { namespace internal {
+
+	enum case_status
+	{
+		CASE_PASSED,
+		CASE_FAILED,    // assertion failure
+		CASE_ERROR      // other exception
+	};
+
+	struct case_record
+	{
+		const test_case *tcase;
+		timer tm;
+		case_status status;
+		std::string message;
+		std::string file;
+		unsigned int line;
+
+		case_record()
+		: tcase(0), status(CASE_PASSED), line(0) { }
+
+		void set_failure(const assertion_failure& e)
+		{
+			status = CASE_FAILED;
+			message = e.what();
+			file = e.file_name();
+			line = e.line_number();
+		}
+
+		void set_error(const std::exception& e)
+		{
+			status = CASE_ERROR;
+			message = e.what() != 0 ? e.what() : "Unknown cause";
+		}
+
+		// the executor reported a failure that no callback explained
+		void set_unexplained_failure()
+		{
+			status = CASE_ERROR;
+			message = "The case failed without a reported cause";
+		}
+
+		// expectation failures are added to an earlier failure or error
+		void add_expectation_failures(const expectation_log& log)
+		{
+			if (status == CASE_PASSED)
+			{
+				status = CASE_FAILED;
+				message = log.str();
+				file = log.records[0].file;
+				line = log.records[0].line;
+			}
+			else
+			{
+				message += "\n";
+				message += log.str();
+			}
+		}
+	};
+
+
+	/**
+	 * Keeps the record of the case running on each thread, so that
+	 * case-level callbacks coming from different threads do not mix.
+	 *
+	 * The table itself is not locked, the owning monitor is expected
+	 * to serialize the accesses.
+	 */
+	class case_record_table
+	{
+	public:
+		case_record& open(const test_case& tcase)
+		{
+			case_record& r = m_records[std::this_thread::get_id()];
+			r = case_record();
+			r.tcase = &tcase;
+			r.tm.start();
+			return r;
+		}
+
+		case_record* current()
+		{
+			std::map<std::thread::id, case_record>::iterator it =
+					m_records.find(std::this_thread::get_id());
+			return it != m_records.end() && it->second.tcase ? &(it->second) : 0;
+		}
+
+		void close()
+		{
+			m_records.erase(std::this_thread::get_id());
+		}
+
+	private:
+		std::map<std::thread::id, case_record> m_records;
+	};
+
+} }
+
+#endif
@@ -15,6 +15,7 @@
 
 #include <time.h>
 #include <sys/time.h>
+#include <stdint.h>
 
 #ifdef __MACH__
 #include <mach/mach_time.h>
@@ -26,6 +27,15 @@
 	#define LTEST_ENSURE_INLINE __attribute__((always_inline))
 #endif
 
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+	#define LTEST_HAS_TSC
+	#ifdef _MSC_VER
+		#include <intrin.h>
+	#else
+		#include <x86intrin.h>
+	#endif
+#endif
+
 namespace ltest { namespace internal {
 
 #ifdef __MACH__
@@ -81,6 +91,62 @@ namespace ltest { namespace internal {
 #endif
 
 
+	// a cheap tick counter for timing short intervals: the time-stamp
+	// counter on x86 (assumed to be invariant), and nanoseconds elsewhere.
+	// The fences keep the timed code between the two reads.
+
+#ifdef LTEST_HAS_TSC
+
+	LTEST_ENSURE_INLINE
+	inline uint64_t read_ticks_begin()
+	{
+		_mm_lfence();
+		return __rdtsc();
+	}
+
+	LTEST_ENSURE_INLINE
+	inline uint64_t read_ticks_end()
+	{
+		unsigned int aux;
+		uint64_t t = __rdtscp(&aux);
+		_mm_lfence();
+		return t;
+	}
+
+	// without ordering against the surrounding code (for timestamps)
+	LTEST_ENSURE_INLINE
+	inline uint64_t read_ticks()
+	{
+		return __rdtsc();
+	}
+
+#else
+
+	inline uint64_t read_ticks_begin()
+	{
+#ifdef __MACH__
+		static mach_timebase_info_data_t info = { 0, 0 };
+		if (info.denom == 0) ::mach_timebase_info(&info);
+		return ::mach_absolute_time() * info.numer / info.denom;
+#else
+		timespec t;
+		::clock_gettime(CLOCK_MONOTONIC, &t);
+		return (uint64_t)t.tv_sec * 1000000000ULL + (uint64_t)t.tv_nsec;
+#endif
+	}
+
+	inline uint64_t read_ticks_end()
+	{
+		return read_ticks_begin();
+	}
+
+	inline uint64_t read_ticks()
+	{
+		return read_ticks_begin();
+	}
+
+#endif
+
 } }
 
 #endif
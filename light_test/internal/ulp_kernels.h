@@ -0,0 +1,353 @@
+/**
+ * @file ulp_kernels.h
+ *
+ * @brief Kernels for computing ULP distances over arrays
+ *
+ * A float (double) is mapped to a signed 32-bit (64-bit) integer whose
+ * order agrees with that of the floating-point values (-0 and +0 both
+ * map to 0), so that the ULP distance between two values is the
+ * difference of their integers. Both NaN gives a distance of 0, a
+ * single NaN gives the maximum distance.
+ *
+ * @author Dahua Lin
+ */
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#ifndef LIGHT_TEST_ULP_KERNELS_H_
+#define LIGHT_TEST_ULP_KERNELS_H_
+
+#include "vec_kernels.h"
+#include <cstring>
+
+#ifdef LTEST_USE_C11_STDLIB
+#include <cstdint>
+#else
+#include <stdint.h>
+#endif
+
+namespace ltest { namespace internal {
+
+#ifdef LTEST_USE_C11_STDLIB
+	using std::int32_t;
+	using std::int64_t;
+	using std::uint32_t;
+	using std::uint64_t;
+#else
+	using ::int32_t;
+	using ::int64_t;
+	using ::uint32_t;
+	using ::uint64_t;
+#endif
+
+	template<typename T> struct ulp_repr;
+
+	template<> struct ulp_repr<float>
+	{
+		typedef int32_t sint_t;
+		typedef uint32_t uint_t;
+
+		static const sint_t abs_mask = 0x7fffffff;
+		static const sint_t inf_bits = 0x7f800000;
+		static const int sign_shift = 31;
+	};
+
+	template<> struct ulp_repr<double>
+	{
+		typedef int64_t sint_t;
+		typedef uint64_t uint_t;
+
+		static const sint_t abs_mask = 0x7fffffffffffffffLL;
+		static const sint_t inf_bits = 0x7ff0000000000000LL;
+		static const int sign_shift = 63;
+	};
+
+
+	// maps between a value and its ordered integer
+
+	template<typename T>
+	inline typename ulp_repr<T>::sint_t to_ordered(T x)
+	{
+		typedef ulp_repr<T> R;
+		typename R::sint_t i;
+		std::memcpy(&i, &x, sizeof(T));
+		return i < 0 ? -(i & R::abs_mask) : i;
+	}
+
+	template<typename T>
+	inline T from_ordered(typename ulp_repr<T>::sint_t i)
+	{
+		typedef ulp_repr<T> R;
+		typename R::uint_t u = i < 0 ?
+				(typename R::uint_t)(-i) | ((typename R::uint_t)1 << R::sign_shift) :
+				(typename R::uint_t)i;
+		T x;
+		std::memcpy(&x, &u, sizeof(T));
+		return x;
+	}
+
+
+	/************************************************
+	 *
+	 *  scalar kernels (branch-free, so that the
+	 *  loops can be auto-vectorized)
+	 *
+	 ************************************************/
+
+	template<typename T>
+	inline typename ulp_repr<T>::uint_t ulp_diff_scalar(T a, T b)
+	{
+		typedef ulp_repr<T> R;
+		typedef typename R::sint_t sint_t;
+		typedef typename R::uint_t uint_t;
+
+		sint_t ia, ib;
+		std::memcpy(&ia, &a, sizeof(T));
+		std::memcpy(&ib, &b, sizeof(T));
+
+		sint_t ma = ia & R::abs_mask;
+		sint_t mb = ib & R::abs_mask;
+		sint_t sa = ia >> R::sign_shift;   // 0 or -1
+		sint_t sb = ib >> R::sign_shift;
+		sint_t oa = (ma ^ sa) - sa;
+		sint_t ob = (mb ^ sb) - sb;
+
+		uint_t d = oa > ob ? (uint_t)oa - (uint_t)ob : (uint_t)ob - (uint_t)oa;
+
+		bool na = ma > R::inf_bits;
+		bool nb = mb > R::inf_bits;
+		uint_t dn = (na && nb) ? uint_t(0) : ~uint_t(0);
+
+		return (na || nb) ? dn : d;
+	}
+
+	template<typename T>
+	inline void ulp_diffs_scalar(size_t n, const T *a, const T *b, typename ulp_repr<T>::uint_t *out)
+	{
+		for (size_t i = 0; i < n; ++i)
+		{
+			out[i] = ulp_diff_scalar(a[i], b[i]);
+		}
+	}
+
+	template<typename T>
+	inline typename ulp_repr<T>::uint_t max_ulp_diff_scalar(size_t n, const T *a, const T *b)
+	{
+		typename ulp_repr<T>::uint_t r = 0;
+		for (size_t i = 0; i < n; ++i)
+		{
+			typename ulp_repr<T>::uint_t d = ulp_diff_scalar(a[i], b[i]);
+			r = d > r ? d : r;
+		}
+		return r;
+	}
+
+
+#ifdef LTEST_X86_DISPATCH
+
+	/************************************************
+	 *
+	 *  AVX2 kernels
+	 *
+	 ************************************************/
+
+	LTEST_TARGET("avx2")
+	inline __m256i ulp_diff_avx2_ps(__m256i ia, __m256i ib, __m256i abs_mask, __m256i inf_bits)
+	{
+		__m256i ma = _mm256_and_si256(ia, abs_mask);
+		__m256i mb = _mm256_and_si256(ib, abs_mask);
+		__m256i sa = _mm256_srai_epi32(ia, 31);
+		__m256i sb = _mm256_srai_epi32(ib, 31);
+		__m256i oa = _mm256_sub_epi32(_mm256_xor_si256(ma, sa), sa);
+		__m256i ob = _mm256_sub_epi32(_mm256_xor_si256(mb, sb), sb);
+		__m256i d = _mm256_sub_epi32(_mm256_max_epi32(oa, ob), _mm256_min_epi32(oa, ob));
+
+		__m256i na = _mm256_cmpgt_epi32(ma, inf_bits);
+		__m256i nb = _mm256_cmpgt_epi32(mb, inf_bits);
+		__m256i dn = _mm256_andnot_si256(_mm256_and_si256(na, nb), _mm256_set1_epi32(-1));
+		return _mm256_blendv_epi8(d, dn, _mm256_or_si256(na, nb));
+	}
+
+	LTEST_TARGET("avx2")
+	inline __m256i ulp_diff_avx2_pd(__m256i ia, __m256i ib, __m256i abs_mask, __m256i inf_bits)
+	{
+		__m256i zero = _mm256_setzero_si256();
+		__m256i ma = _mm256_and_si256(ia, abs_mask);
+		__m256i mb = _mm256_and_si256(ib, abs_mask);
+		__m256i sa = _mm256_cmpgt_epi64(zero, ia);
+		__m256i sb = _mm256_cmpgt_epi64(zero, ib);
+		__m256i oa = _mm256_sub_epi64(_mm256_xor_si256(ma, sa), sa);
+		__m256i ob = _mm256_sub_epi64(_mm256_xor_si256(mb, sb), sb);
+		__m256i gt = _mm256_cmpgt_epi64(oa, ob);
+		__m256i d = _mm256_sub_epi64(_mm256_blendv_epi8(ob, oa, gt), _mm256_blendv_epi8(oa, ob, gt));
+
+		__m256i na = _mm256_cmpgt_epi64(ma, inf_bits);
+		__m256i nb = _mm256_cmpgt_epi64(mb, inf_bits);
+		__m256i dn = _mm256_andnot_si256(_mm256_and_si256(na, nb), _mm256_set1_epi32(-1));
+		return _mm256_blendv_epi8(d, dn, _mm256_or_si256(na, nb));
+	}
+
+	LTEST_TARGET("avx2")
+	inline uint32_t max_ulp_diff_avx2(size_t n, const float *a, const float *b)
+	{
+		const __m256i abs_mask = _mm256_set1_epi32(ulp_repr<float>::abs_mask);
+		const __m256i inf_bits = _mm256_set1_epi32(ulp_repr<float>::inf_bits);
+
+		__m256i acc = _mm256_setzero_si256();
+		size_t i = 0;
+		for (; i + 8 <= n; i += 8)
+		{
+			__m256i ia = _mm256_loadu_si256((const __m256i*)(a + i));
+			__m256i ib = _mm256_loadu_si256((const __m256i*)(b + i));
+			acc = _mm256_max_epu32(acc, ulp_diff_avx2_ps(ia, ib, abs_mask, inf_bits));
+		}
+
+		uint32_t buf[8];
+		_mm256_storeu_si256((__m256i*)buf, acc);
+
+		uint32_t r = max_ulp_diff_scalar(n - i, a + i, b + i);
+		for (int k = 0; k < 8; ++k) r = buf[k] > r ? buf[k] : r;
+		return r;
+	}
+
+	LTEST_TARGET("avx2")
+	inline uint64_t max_ulp_diff_avx2(size_t n, const double *a, const double *b)
+	{
+		const __m256i abs_mask = _mm256_set1_epi64x(ulp_repr<double>::abs_mask);
+		const __m256i inf_bits = _mm256_set1_epi64x(ulp_repr<double>::inf_bits);
+		const __m256i sbit = _mm256_set1_epi64x((int64_t)0x8000000000000000ULL);
+
+		__m256i acc = _mm256_setzero_si256();
+		size_t i = 0;
+		for (; i + 4 <= n; i += 4)
+		{
+			__m256i ia = _mm256_loadu_si256((const __m256i*)(a + i));
+			__m256i ib = _mm256_loadu_si256((const __m256i*)(b + i));
+			__m256i d = ulp_diff_avx2_pd(ia, ib, abs_mask, inf_bits);
+
+			// unsigned comparison via flipping the sign bits
+			__m256i gt = _mm256_cmpgt_epi64(_mm256_xor_si256(d, sbit), _mm256_xor_si256(acc, sbit));
+			acc = _mm256_blendv_epi8(acc, d, gt);
+		}
+
+		uint64_t buf[4];
+		_mm256_storeu_si256((__m256i*)buf, acc);
+
+		uint64_t r = max_ulp_diff_scalar(n - i, a + i, b + i);
+		for (int k = 0; k < 4; ++k) r = buf[k] > r ? buf[k] : r;
+		return r;
+	}
+
+
+	/************************************************
+	 *
+	 *  AVX-512 kernels
+	 *
+	 ************************************************/
+
+	// the mapping and the abs difference are done with masked operations,
+	// which also keeps clear of _mm512_undefined_* (and the spurious
+	// -Wmaybe-uninitialized warnings it produces with some GCC versions)
+
+	LTEST_TARGET("avx512f")
+	inline uint32_t max_ulp_diff_avx512(size_t n, const float *a, const float *b)
+	{
+		const __m512i abs_mask = _mm512_set1_epi32(ulp_repr<float>::abs_mask);
+		const __m512i inf_bits = _mm512_set1_epi32(ulp_repr<float>::inf_bits);
+		const __m512i ones = _mm512_set1_epi32(-1);
+		const __m512i zero = _mm512_setzero_si512();
+
+		__m512i acc = zero;
+		size_t i = 0;
+		for (; i + 16 <= n; i += 16)
+		{
+			__m512i ia = _mm512_loadu_si512((const void*)(a + i));
+			__m512i ib = _mm512_loadu_si512((const void*)(b + i));
+
+			__m512i ma = _mm512_and_si512(ia, abs_mask);
+			__m512i mb = _mm512_and_si512(ib, abs_mask);
+			__m512i oa = _mm512_mask_sub_epi32(ma, _mm512_cmplt_epi32_mask(ia, zero), zero, ma);
+			__m512i ob = _mm512_mask_sub_epi32(mb, _mm512_cmplt_epi32_mask(ib, zero), zero, mb);
+			__m512i d = _mm512_mask_sub_epi32(_mm512_sub_epi32(ob, oa), _mm512_cmpgt_epi32_mask(oa, ob), oa, ob);
+
+			__mmask16 na = _mm512_cmpgt_epi32_mask(ma, inf_bits);
+			__mmask16 nb = _mm512_cmpgt_epi32_mask(mb, inf_bits);
+			d = _mm512_mask_blend_epi32((__mmask16)(na | nb), d, ones);
+			d = _mm512_mask_blend_epi32((__mmask16)(na & nb), d, zero);
+
+			acc = _mm512_mask_mov_epi32(acc, _mm512_cmpgt_epu32_mask(d, acc), d);
+		}
+
+		uint32_t buf[16];
+		_mm512_storeu_si512((void*)buf, acc);
+
+		uint32_t r = max_ulp_diff_scalar(n - i, a + i, b + i);
+		for (int k = 0; k < 16; ++k) r = buf[k] > r ? buf[k] : r;
+		return r;
+	}
+
+	LTEST_TARGET("avx512f")
+	inline uint64_t max_ulp_diff_avx512(size_t n, const double *a, const double *b)
+	{
+		const __m512i abs_mask = _mm512_set1_epi64(ulp_repr<double>::abs_mask);
+		const __m512i inf_bits = _mm512_set1_epi64(ulp_repr<double>::inf_bits);
+		const __m512i ones = _mm512_set1_epi64(-1);
+		const __m512i zero = _mm512_setzero_si512();
+
+		__m512i acc = zero;
+		size_t i = 0;
+		for (; i + 8 <= n; i += 8)
+		{
+			__m512i ia = _mm512_loadu_si512((const void*)(a + i));
+			__m512i ib = _mm512_loadu_si512((const void*)(b + i));
+
+			__m512i ma = _mm512_and_si512(ia, abs_mask);
+			__m512i mb = _mm512_and_si512(ib, abs_mask);
+			__m512i oa = _mm512_mask_sub_epi64(ma, _mm512_cmplt_epi64_mask(ia, zero), zero, ma);
+			__m512i ob = _mm512_mask_sub_epi64(mb, _mm512_cmplt_epi64_mask(ib, zero), zero, mb);
+			__m512i d = _mm512_mask_sub_epi64(_mm512_sub_epi64(ob, oa), _mm512_cmpgt_epi64_mask(oa, ob), oa, ob);
+
+			__mmask8 na = _mm512_cmpgt_epi64_mask(ma, inf_bits);
+			__mmask8 nb = _mm512_cmpgt_epi64_mask(mb, inf_bits);
+			d = _mm512_mask_blend_epi64((__mmask8)(na | nb), d, ones);
+			d = _mm512_mask_blend_epi64((__mmask8)(na & nb), d, zero);
+
+			acc = _mm512_mask_mov_epi64(acc, _mm512_cmpgt_epu64_mask(d, acc), d);
+		}
+
+		uint64_t buf[8];
+		_mm512_storeu_si512((void*)buf, acc);
+
+		uint64_t r = max_ulp_diff_scalar(n - i, a + i, b + i);
+		for (int k = 0; k < 8; ++k) r = buf[k] > r ? buf[k] : r;
+		return r;
+	}
+
+#endif
+
+
+	/************************************************
+	 *
+	 *  dispatched kernels
+	 *
+	 ************************************************/
+
+	template<typename T>
+	inline typename ulp_repr<T>::uint_t max_ulp_diff(size_t n, const T *a, const T *b)
+	{
+#ifdef LTEST_X86_DISPATCH
+		switch (current_simd_level())
+		{
+		case SIMD_AVX512: return max_ulp_diff_avx512(n, a, b);
+		case SIMD_AVX2:   return max_ulp_diff_avx2(n, a, b);
+		default: break;
+		}
+#endif
+		return max_ulp_diff_scalar(n, a, b);
+	}
+
+} }
+
+#endif
@@ -0,0 +1,354 @@
+/**
+ * @file vec_kernels.h
+ *
+ * @brief SIMD kernels for comparing contiguous float/double arrays
+ *
+ * The instruction set (SSE2, AVX2 or AVX-512) is chosen at runtime
+ * according to the running CPU. On other platforms and compilers,
+ * the scalar kernels are used.
+ *
+ * @author Dahua Lin
+ */
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#ifndef LIGHT_TEST_VEC_KERNELS_H_
+#define LIGHT_TEST_VEC_KERNELS_H_
+
+#include <cstddef>
+#include <cmath>
+
+#if (defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)))
+	#define LTEST_X86_DISPATCH
+	#define LTEST_TARGET(isa) __attribute__((target(isa)))
+	#include <immintrin.h>
+#endif
+
+namespace ltest { namespace internal {
+
+	using std::size_t;
+
+	enum simd_level
+	{
+		SIMD_NONE,
+		SIMD_SSE2,
+		SIMD_AVX2,
+		SIMD_AVX512
+	};
+
+	inline simd_level detect_simd_level()
+	{
+#ifdef LTEST_X86_DISPATCH
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx512f")) return SIMD_AVX512;
+		if (__builtin_cpu_supports("avx2")) return SIMD_AVX2;
+		if (__builtin_cpu_supports("sse2")) return SIMD_SSE2;
+#endif
+		return SIMD_NONE;
+	}
+
+	inline simd_level current_simd_level()
+	{
+		static const simd_level lv = detect_simd_level();
+		return lv;
+	}
+
+
+	/************************************************
+	 *
+	 *  scalar kernels
+	 *
+	 ************************************************/
+
+	template<typename T>
+	inline bool vec_equal_scalar(size_t n, const T *a, const T *b)
+	{
+		for (size_t i = 0; i < n; ++i)
+		{
+			if (!(a[i] == b[i])) return false;
+		}
+		return true;
+	}
+
+	template<typename T>
+	inline bool vec_approx_scalar(size_t n, const T *a, const T *b, T tol, bool with_eq)
+	{
+		for (size_t i = 0; i < n; ++i)
+		{
+			if (!( (with_eq && a[i] == b[i]) || std::fabs(a[i] - b[i]) <= tol )) return false;
+		}
+		return true;
+	}
+
+
+#ifdef LTEST_X86_DISPATCH
+
+	/************************************************
+	 *
+	 *  per-ISA operations
+	 *
+	 *  eq:   a == b
+	 *  near: -tol <= a - b <= tol (false for NaN), or a == b if with_eq
+	 *
+	 ************************************************/
+
+	template<typename T> struct sse2_ops;
+	template<typename T> struct avx2_ops;
+	template<typename T> struct avx512_ops;
+
+	template<> struct sse2_ops<float>
+	{
+		typedef __m128 vec_t;
+		typedef __m128 mask_t;
+		static const size_t width = 4;
+
+		LTEST_TARGET("sse2") static vec_t set1(float v) { return _mm_set1_ps(v); }
+
+		LTEST_TARGET("sse2") static mask_t eq(const float *a, const float *b)
+		{
+			return _mm_cmpeq_ps(_mm_loadu_ps(a), _mm_loadu_ps(b));
+		}
+
+		LTEST_TARGET("sse2") static mask_t near(const float *a, const float *b, vec_t tol, vec_t ntol, bool with_eq)
+		{
+			vec_t va = _mm_loadu_ps(a);
+			vec_t vb = _mm_loadu_ps(b);
+			vec_t d = _mm_sub_ps(va, vb);
+			mask_t m = _mm_and_ps(_mm_cmple_ps(d, tol), _mm_cmple_ps(ntol, d));
+			return with_eq ? _mm_or_ps(_mm_cmpeq_ps(va, vb), m) : m;
+		}
+
+		LTEST_TARGET("sse2") static mask_t and_(mask_t x, mask_t y) { return _mm_and_ps(x, y); }
+
+		LTEST_TARGET("sse2") static bool all(mask_t m) { return _mm_movemask_ps(m) == 0xf; }
+	};
+
+	template<> struct sse2_ops<double>
+	{
+		typedef __m128d vec_t;
+		typedef __m128d mask_t;
+		static const size_t width = 2;
+
+		LTEST_TARGET("sse2") static vec_t set1(double v) { return _mm_set1_pd(v); }
+
+		LTEST_TARGET("sse2") static mask_t eq(const double *a, const double *b)
+		{
+			return _mm_cmpeq_pd(_mm_loadu_pd(a), _mm_loadu_pd(b));
+		}
+
+		LTEST_TARGET("sse2") static mask_t near(const double *a, const double *b, vec_t tol, vec_t ntol, bool with_eq)
+		{
+			vec_t va = _mm_loadu_pd(a);
+			vec_t vb = _mm_loadu_pd(b);
+			vec_t d = _mm_sub_pd(va, vb);
+			mask_t m = _mm_and_pd(_mm_cmple_pd(d, tol), _mm_cmple_pd(ntol, d));
+			return with_eq ? _mm_or_pd(_mm_cmpeq_pd(va, vb), m) : m;
+		}
+
+		LTEST_TARGET("sse2") static mask_t and_(mask_t x, mask_t y) { return _mm_and_pd(x, y); }
+
+		LTEST_TARGET("sse2") static bool all(mask_t m) { return _mm_movemask_pd(m) == 0x3; }
+	};
+
+	template<> struct avx2_ops<float>
+	{
+		typedef __m256 vec_t;
+		typedef __m256 mask_t;
+		static const size_t width = 8;
+
+		LTEST_TARGET("avx2") static vec_t set1(float v) { return _mm256_set1_ps(v); }
+
+		LTEST_TARGET("avx2") static mask_t eq(const float *a, const float *b)
+		{
+			return _mm256_cmp_ps(_mm256_loadu_ps(a), _mm256_loadu_ps(b), _CMP_EQ_OQ);
+		}
+
+		LTEST_TARGET("avx2") static mask_t near(const float *a, const float *b, vec_t tol, vec_t ntol, bool with_eq)
+		{
+			vec_t va = _mm256_loadu_ps(a);
+			vec_t vb = _mm256_loadu_ps(b);
+			vec_t d = _mm256_sub_ps(va, vb);
+			mask_t m = _mm256_and_ps(_mm256_cmp_ps(d, tol, _CMP_LE_OQ), _mm256_cmp_ps(ntol, d, _CMP_LE_OQ));
+			return with_eq ? _mm256_or_ps(_mm256_cmp_ps(va, vb, _CMP_EQ_OQ), m) : m;
+		}
+
+		LTEST_TARGET("avx2") static mask_t and_(mask_t x, mask_t y) { return _mm256_and_ps(x, y); }
+
+		LTEST_TARGET("avx2") static bool all(mask_t m) { return _mm256_movemask_ps(m) == 0xff; }
+	};
+
+	template<> struct avx2_ops<double>
+	{
+		typedef __m256d vec_t;
+		typedef __m256d mask_t;
+		static const size_t width = 4;
+
+		LTEST_TARGET("avx2") static vec_t set1(double v) { return _mm256_set1_pd(v); }
+
+		LTEST_TARGET("avx2") static mask_t eq(const double *a, const double *b)
+		{
+			return _mm256_cmp_pd(_mm256_loadu_pd(a), _mm256_loadu_pd(b), _CMP_EQ_OQ);
+		}
+
+		LTEST_TARGET("avx2") static mask_t near(const double *a, const double *b, vec_t tol, vec_t ntol, bool with_eq)
+		{
+			vec_t va = _mm256_loadu_pd(a);
+			vec_t vb = _mm256_loadu_pd(b);
+			vec_t d = _mm256_sub_pd(va, vb);
+			mask_t m = _mm256_and_pd(_mm256_cmp_pd(d, tol, _CMP_LE_OQ), _mm256_cmp_pd(ntol, d, _CMP_LE_OQ));
+			return with_eq ? _mm256_or_pd(_mm256_cmp_pd(va, vb, _CMP_EQ_OQ), m) : m;
+		}
+
+		LTEST_TARGET("avx2") static mask_t and_(mask_t x, mask_t y) { return _mm256_and_pd(x, y); }
+
+		LTEST_TARGET("avx2") static bool all(mask_t m) { return _mm256_movemask_pd(m) == 0xf; }
+	};
+
+	template<> struct avx512_ops<float>
+	{
+		typedef __m512 vec_t;
+		typedef __mmask16 mask_t;
+		static const size_t width = 16;
+
+		LTEST_TARGET("avx512f") static vec_t set1(float v) { return _mm512_set1_ps(v); }
+
+		LTEST_TARGET("avx512f") static mask_t eq(const float *a, const float *b)
+		{
+			return _mm512_cmp_ps_mask(_mm512_loadu_ps(a), _mm512_loadu_ps(b), _CMP_EQ_OQ);
+		}
+
+		LTEST_TARGET("avx512f") static mask_t near(const float *a, const float *b, vec_t tol, vec_t ntol, bool with_eq)
+		{
+			vec_t va = _mm512_loadu_ps(a);
+			vec_t vb = _mm512_loadu_ps(b);
+			vec_t d = _mm512_sub_ps(va, vb);
+			mask_t m = _mm512_mask_cmp_ps_mask(_mm512_cmp_ps_mask(d, tol, _CMP_LE_OQ), ntol, d, _CMP_LE_OQ);
+			return with_eq ? (mask_t)(_mm512_cmp_ps_mask(va, vb, _CMP_EQ_OQ) | m) : m;
+		}
+
+		LTEST_TARGET("avx512f") static mask_t and_(mask_t x, mask_t y) { return (mask_t)(x & y); }
+
+		LTEST_TARGET("avx512f") static bool all(mask_t m) { return m == 0xffff; }
+	};
+
+	template<> struct avx512_ops<double>
+	{
+		typedef __m512d vec_t;
+		typedef __mmask8 mask_t;
+		static const size_t width = 8;
+
+		LTEST_TARGET("avx512f") static vec_t set1(double v) { return _mm512_set1_pd(v); }
+
+		LTEST_TARGET("avx512f") static mask_t eq(const double *a, const double *b)
+		{
+			return _mm512_cmp_pd_mask(_mm512_loadu_pd(a), _mm512_loadu_pd(b), _CMP_EQ_OQ);
+		}
+
+		LTEST_TARGET("avx512f") static mask_t near(const double *a, const double *b, vec_t tol, vec_t ntol, bool with_eq)
+		{
+			vec_t va = _mm512_loadu_pd(a);
+			vec_t vb = _mm512_loadu_pd(b);
+			vec_t d = _mm512_sub_pd(va, vb);
+			mask_t m = _mm512_mask_cmp_pd_mask(_mm512_cmp_pd_mask(d, tol, _CMP_LE_OQ), ntol, d, _CMP_LE_OQ);
+			return with_eq ? (mask_t)(_mm512_cmp_pd_mask(va, vb, _CMP_EQ_OQ) | m) : m;
+		}
+
+		LTEST_TARGET("avx512f") static mask_t and_(mask_t x, mask_t y) { return (mask_t)(x & y); }
+
+		LTEST_TARGET("avx512f") static bool all(mask_t m) { return m == 0xff; }
+	};
+
+
+	/************************************************
+	 *
+	 *  per-ISA kernels
+	 *
+	 *  The main loops check four vectors at a time,
+	 *  the remainder is handled by the scalar kernels.
+	 *
+	 ************************************************/
+
+#define LTEST_DEFINE_VEC_KERNELS(isa, target_str) \
+	template<typename T> \
+	LTEST_TARGET(target_str) \
+	inline bool vec_equal_##isa(size_t n, const T *a, const T *b) { \
+		typedef isa##_ops<T> ops; \
+		const size_t w = ops::width; \
+		size_t i = 0; \
+		for (; i + 4 * w <= n; i += 4 * w) { \
+			typename ops::mask_t m = ops::and_( \
+					ops::and_(ops::eq(a + i, b + i), ops::eq(a + i + w, b + i + w)), \
+					ops::and_(ops::eq(a + i + 2 * w, b + i + 2 * w), ops::eq(a + i + 3 * w, b + i + 3 * w))); \
+			if (!ops::all(m)) return false; } \
+		for (; i + w <= n; i += w) { \
+			if (!ops::all(ops::eq(a + i, b + i))) return false; } \
+		return vec_equal_scalar(n - i, a + i, b + i); } \
+	\
+	template<typename T> \
+	LTEST_TARGET(target_str) \
+	inline bool vec_approx_##isa(size_t n, const T *a, const T *b, T tol, bool with_eq) { \
+		typedef isa##_ops<T> ops; \
+		const size_t w = ops::width; \
+		const typename ops::vec_t vt = ops::set1(tol); \
+		const typename ops::vec_t vn = ops::set1(-tol); \
+		size_t i = 0; \
+		for (; i + 4 * w <= n; i += 4 * w) { \
+			typename ops::mask_t m = ops::and_( \
+					ops::and_(ops::near(a + i, b + i, vt, vn, with_eq), ops::near(a + i + w, b + i + w, vt, vn, with_eq)), \
+					ops::and_(ops::near(a + i + 2 * w, b + i + 2 * w, vt, vn, with_eq), ops::near(a + i + 3 * w, b + i + 3 * w, vt, vn, with_eq))); \
+			if (!ops::all(m)) return false; } \
+		for (; i + w <= n; i += w) { \
+			if (!ops::all(ops::near(a + i, b + i, vt, vn, with_eq))) return false; } \
+		return vec_approx_scalar(n - i, a + i, b + i, tol, with_eq); }
+
+	LTEST_DEFINE_VEC_KERNELS(sse2, "sse2")
+	LTEST_DEFINE_VEC_KERNELS(avx2, "avx2")
+	LTEST_DEFINE_VEC_KERNELS(avx512, "avx512f")
+
+#undef LTEST_DEFINE_VEC_KERNELS
+
+#endif
+
+
+	/************************************************
+	 *
+	 *  dispatched kernels
+	 *
+	 ************************************************/
+
+	template<typename T>
+	inline bool vec_equal(size_t n, const T *a, const T *b)
+	{
+#ifdef LTEST_X86_DISPATCH
+		switch (current_simd_level())
+		{
+		case SIMD_AVX512: return vec_equal_avx512(n, a, b);
+		case SIMD_AVX2:   return vec_equal_avx2(n, a, b);
+		case SIMD_SSE2:   return vec_equal_sse2(n, a, b);
+		default: break;
+		}
+#endif
+		return vec_equal_scalar(n, a, b);
+	}
+
+	// with_eq: also accept a == b (e.g. equal infinities)
+	template<typename T>
+	inline bool vec_approx(size_t n, const T *a, const T *b, T tol, bool with_eq)
+	{
+#ifdef LTEST_X86_DISPATCH
+		switch (current_simd_level())
+		{
+		case SIMD_AVX512: return vec_approx_avx512(n, a, b, tol, with_eq);
+		case SIMD_AVX2:   return vec_approx_avx2(n, a, b, tol, with_eq);
+		case SIMD_SSE2:   return vec_approx_sse2(n, a, b, tol, with_eq);
+		default: break;
+		}
+#endif
+		return vec_approx_scalar(n, a, b, tol, with_eq);
+	}
+
+} }
+
+#endif
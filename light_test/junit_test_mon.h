@@ -0,0 +1,249 @@
+/**
+ * @file junit_test_mon.h
+ *
+ * Testing monitor that writes JUnit XML reports
+ *
+ * @author Dahua Lin
+ */
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#ifndef LIGHT_TEST_JUNIT_TEST_MON_H_
+#define LIGHT_TEST_JUNIT_TEST_MON_H_
+
+#include "test_assertions.h"
+#include "test_units.h"
+#include "test_mon.h"
+#include "str_template.h"
+#include "internal/case_record.h"
+
+#include <ostream>
+
+namespace ltest
+{
+
+	inline std::string xml_escape(const char *s)
+	{
+		std::string r;
+		for (; *s; ++s)
+		{
+			switch (*s)
+			{
+			case '<':  r += "&lt;"; break;
+			case '>':  r += "&gt;"; break;
+			case '&':  r += "&amp;"; break;
+			case '"':  r += "&quot;"; break;
+			case '\'': r += "&apos;"; break;
+			case '\n': r += "&#10;"; break;
+			default:   r += *s;
+			}
+		}
+		return r;
+	}
+
+	inline std::string xml_escape(const std::string& s)
+	{
+		return xml_escape(s.c_str());
+	}
+
+
+	/**
+	 * Writes one \<testsuite\> element per test pack.
+	 *
+	 * The \<testcase\> elements of a pack are accumulated in a buffer
+	 * and flushed to the output when the pack ends, so that the pack
+	 * element can carry the counts. Nothing is retained across packs.
+	 *
+	 * Case-level callbacks may come from different threads at the same
+	 * time; pack and suite callbacks are expected from a single thread.
+	 */
+	class junit_test_monitor : public test_monitor
+	{
+	public:
+		explicit junit_test_monitor(std::ostream& out)
+		: m_out(out)
+		, m_pack_cases(0), m_pack_failures(0), m_pack_errors(0)
+		{
+			m_out << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n";
+		}
+
+	public:
+		virtual void on_suite_begin(const test_suite& tsuite)
+		{
+			m_out << "<testsuites name=\"" << xml_escape(tsuite.name()) << "\">\n";
+			m_out.flush();
+
+			m_suite_name = tsuite.name();
+			reset_pack(m_suite_name);
+		}
+
+		virtual void on_suite_end(const test_suite& tsuite, size_t nfinished_cases, size_t npassed_cases)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			// errors from the suite fixture, if any
+			if (!m_pack_buffer.empty()) write_pack();
+
+			m_out << "</testsuites>\n";
+			m_out.flush();
+		}
+
+		virtual void on_pack_begin(const test_pack& tpack)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			if (!m_pack_buffer.empty()) write_pack();
+			reset_pack(tpack.name());
+		}
+
+		virtual void on_pack_end(const test_pack& tpack, size_t npassed_cases)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			write_pack();
+			reset_pack(m_suite_name);
+		}
+
+		virtual void on_case_begin(const test_case& tcase)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_records.open(tcase);
+		}
+
+		virtual void on_case_end(const test_case& tcase, bool is_passed)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			internal::case_record *r = m_records.current();
+			if (!r) return;
+			if (!is_passed && r->status == internal::CASE_PASSED) r->set_unexplained_failure();
+
+			double secs = r->tm.elapsed_secs();
+
+			std::string& buf = m_pack_buffer;
+			buf += "    <testcase classname=\"";
+			buf += xml_escape(m_pack_name);
+			buf += "\" name=\"";
+			buf += xml_escape(tcase.name());
+			buf += "\" time=\"";
+			buf += sformat(secs, "%.6f");
+
+			if (r->status == internal::CASE_PASSED)
+			{
+				buf += "\"/>\n";
+			}
+			else
+			{
+				bool is_failure = r->status == internal::CASE_FAILED;
+				buf += "\">\n      <";
+				buf += is_failure ? "failure" : "error";
+				buf += " message=\"";
+				buf += xml_escape(r->message);
+				buf += "\" type=\"";
+				buf += is_failure ? "assertion_failure" : "exception";
+				buf += "\">";
+				if (is_failure)
+				{
+					buf += xml_escape(r->file);
+					buf += ":";
+					buf += sformat(r->line, "%u");
+				}
+				buf += "</";
+				buf += is_failure ? "failure" : "error";
+				buf += ">\n    </testcase>\n";
+
+				if (is_failure) ++m_pack_failures; else ++m_pack_errors;
+			}
+
+			++m_pack_cases;
+			m_records.close();
+		}
+
+		virtual void on_assertion_failure(const assertion_failure& e)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			internal::case_record *r = m_records.current();
+			if (r) r->set_failure(e);
+			else add_fixture_error(e.what());
+		}
+
+		virtual void on_exception(const std::exception& e)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			internal::case_record *r = m_records.current();
+			if (r) r->set_error(e);
+			else add_fixture_error(e.what() != 0 ? e.what() : "Unknown cause");
+		}
+
+		virtual void on_expectation_failures(const expectation_log& log)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			internal::case_record *r = m_records.current();
+			if (r) r->add_expectation_failures(log);
+			else add_fixture_error(log.str().c_str());
+		}
+
+	private:
+		void reset_pack(const std::string& name)
+		{
+			m_pack_name = name;
+			m_pack_buffer.clear();
+			m_pack_cases = 0;
+			m_pack_failures = 0;
+			m_pack_errors = 0;
+			m_pack_timer.start();
+		}
+
+		void write_pack()
+		{
+			m_out << "  <testsuite name=\"" << xml_escape(m_pack_name) << "\""
+				  << " tests=\"" << m_pack_cases << "\""
+				  << " failures=\"" << m_pack_failures << "\""
+				  << " errors=\"" << m_pack_errors << "\""
+				  << " time=\"" << sformat(m_pack_timer.elapsed_secs(), "%.6f") << "\">\n"
+				  << m_pack_buffer
+				  << "  </testsuite>\n";
+			m_out.flush();
+		}
+
+		// failures outside of cases (in pack or suite fixtures) are
+		// reported as an erroneous pseudo case of the current pack
+
+		void add_fixture_error(const char *msg)
+		{
+			m_pack_buffer += "    <testcase classname=\"";
+			m_pack_buffer += xml_escape(m_pack_name);
+			m_pack_buffer += "\" name=\"(fixture)\" time=\"0\">\n      <error message=\"";
+			m_pack_buffer += xml_escape(msg);
+			m_pack_buffer += "\" type=\"fixture\"></error>\n    </testcase>\n";
+			++m_pack_cases;
+			++m_pack_errors;
+		}
+
+	private:
+		junit_test_monitor(const junit_test_monitor& );
+		junit_test_monitor& operator = (const junit_test_monitor& );
+
+	private:
+		std::ostream& m_out;
+		std::mutex m_mutex;
+		internal::case_record_table m_records;
+
+		std::string m_suite_name;
+		std::string m_pack_name;
+		std::string m_pack_buffer;
+		size_t m_pack_cases;
+		size_t m_pack_failures;
+		size_t m_pack_errors;
+		timer m_pack_timer;
+
+	}; // end class junit_test_monitor
+
+}
+
+#endif /* JUNIT_TEST_MON_H_ */
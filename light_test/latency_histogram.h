@@ -0,0 +1,208 @@
+/**
+ * @file latency_histogram.h
+ *
+ * @brief A fixed-memory histogram of latencies with log-linear bins
+ *
+ * Values below 2^(sub_bits+1) have a bin each. Above that, every range
+ * [2^k, 2^(k+1)) is divided into 2^sub_bits bins of equal width, so the
+ * relative error of a reported value is below 2^-sub_bits (as in HDR
+ * histograms). All bins are allocated on construction, and add() does
+ * not allocate.
+ *
+ * @author Dahua Lin
+ */
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#ifndef LIGHT_TEST_LATENCY_HISTOGRAM_H_
+#define LIGHT_TEST_LATENCY_HISTOGRAM_H_
+
+#include "base.h"
+
+#ifdef LTEST_USE_C11_STDLIB
+#include <cstdint>
+#else
+#include <stdint.h>
+#endif
+
+#include <cmath>
+#include <vector>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// the number of bins per power of two is 2^LTEST_LATENCY_SUB_BITS
+#ifndef LTEST_LATENCY_SUB_BITS
+#define LTEST_LATENCY_SUB_BITS 7
+#endif
+
+namespace ltest
+{
+#ifdef LTEST_USE_C11_STDLIB
+	using std::uint64_t;
+#else
+	using ::uint64_t;
+#endif
+
+	namespace detail
+	{
+		// the index of the highest set bit of x > 0
+		inline unsigned int msb64(uint64_t x)
+		{
+#if defined(__GNUC__)
+			return 63u - (unsigned int)__builtin_clzll(x);
+#elif defined(_MSC_VER) && defined(_M_X64)
+			unsigned long i;
+			_BitScanReverse64(&i, x);
+			return (unsigned int)i;
+#else
+			unsigned int i = 0;
+			while (x >>= 1) ++i;
+			return i;
+#endif
+		}
+	}
+
+
+	class latency_histogram
+	{
+	public:
+		static const unsigned int sub_bits = LTEST_LATENCY_SUB_BITS;
+		static const size_t sub_count = (size_t)1 << sub_bits;
+		static const size_t nbins = (65 - sub_bits) * sub_count;
+
+	public:
+		/**
+		 * unit_nsecs is the length of a unit of the recorded values in
+		 * nanoseconds (e.g. cycle_clock::nsecs_per_tick() for ticks).
+		 */
+		explicit latency_histogram(double unit_nsecs = 1.0)
+		: m_counts(nbins, 0), m_unit_nsecs(unit_nsecs)
+		{
+			clear();
+		}
+
+		static size_t bin_of(uint64_t v)
+		{
+			if (v < 2 * sub_count) return (size_t)v;
+
+			unsigned int shift = detail::msb64(v) - sub_bits;
+			return shift * sub_count + (size_t)(v >> shift);
+		}
+
+		static uint64_t bin_lower(size_t k)
+		{
+			if (k < 2 * sub_count) return k;
+
+			size_t shift = k / sub_count - 1;
+			return (uint64_t)(k - shift * sub_count) << shift;
+		}
+
+		static uint64_t bin_upper(size_t k)
+		{
+			if (k < 2 * sub_count) return k;
+
+			size_t shift = k / sub_count - 1;
+			return (((uint64_t)(k - shift * sub_count) + 1) << shift) - 1;
+		}
+
+	public:
+		void clear()
+		{
+			for (size_t k = 0; k < nbins; ++k) m_counts[k] = 0;
+			m_total = 0;
+			m_sum = 0;
+			m_min = ~(uint64_t)0;
+			m_max = 0;
+		}
+
+		void add(uint64_t v)
+		{
+			++ m_counts[bin_of(v)];
+			++ m_total;
+			m_sum += v;
+			if (v < m_min) m_min = v;
+			if (v > m_max) m_max = v;
+		}
+
+		void merge(const latency_histogram& other)
+		{
+			for (size_t k = 0; k < nbins; ++k) m_counts[k] += other.m_counts[k];
+			m_total += other.m_total;
+			m_sum += other.m_sum;
+			if (other.m_min < m_min) m_min = other.m_min;
+			if (other.m_max > m_max) m_max = other.m_max;
+		}
+
+		double unit_nsecs() const
+		{
+			return m_unit_nsecs;
+		}
+
+		uint64_t count(size_t k) const
+		{
+			return m_counts[k];
+		}
+
+		uint64_t total() const
+		{
+			return m_total;
+		}
+
+		uint64_t min() const
+		{
+			return m_total > 0 ? m_min : 0;
+		}
+
+		uint64_t max() const
+		{
+			return m_max;
+		}
+
+		double mean() const
+		{
+			return m_total > 0 ? double(m_sum) / double(m_total) : 0.0;
+		}
+
+		/**
+		 * The value at quantile q (in [0, 1]), i.e. the smallest recorded
+		 * value v such that a fraction q of the values are <= v, given
+		 * by the middle of its bin (within [min, max]).
+		 */
+		uint64_t value_at(double q) const
+		{
+			if (m_total == 0) return 0;
+
+			uint64_t rank = (uint64_t)std::ceil(q * double(m_total));
+			if (rank < 1) rank = 1;
+			if (rank > m_total) rank = m_total;
+
+			uint64_t c = 0;
+			size_t k = 0;
+			while ((c += m_counts[k]) < rank) ++k;
+
+			uint64_t lo = bin_lower(k);
+			uint64_t v = lo + (bin_upper(k) - lo) / 2;
+			return v < m_min ? m_min : (v > m_max ? m_max : v);
+		}
+
+		double nsecs_at(double q) const
+		{
+			return double(value_at(q)) * m_unit_nsecs;
+		}
+
+	private:
+		std::vector<uint64_t> m_counts;
+		uint64_t m_total;
+		uint64_t m_sum;
+		uint64_t m_min;
+		uint64_t m_max;
+		double m_unit_nsecs;
+	};
+
+}
+
+#endif /* LATENCY_HISTOGRAM_H_ */
@@ -0,0 +1,322 @@
+/**
+ * @file load_benchmark.h
+ *
+ * @brief Open-loop benchmarks under a target arrival rate
+ *
+ * run_load_benchmark issues calls of a job on a fixed schedule, at rate
+ * calls per second (evenly spaced, or as a Poisson process), regardless
+ * of whether the earlier calls have finished. The schedule is divided
+ * among num_threads workers. When a worker falls behind, it makes its
+ * next call at once, and the latency of a call is measured from its
+ * intended start. The time a call waits for the worker is included
+ * (which corrects the coordinated omission of closed-loop measurements),
+ * and the time of the call itself is recorded as the service time.
+ *
+ * Before the schedule, the job is called back to back on the calling
+ * thread until its batch times are steady (as in the warmup of
+ * run_benchmark), for at most max_warming_time seconds. The first warmup
+ * seconds of the schedule are then run without being recorded, which
+ * also warms up the other workers.
+ *
+ * If the schedule cannot be kept, a run ends at twice its duration, and
+ * the calls that were not made by then are recorded with the latency
+ * they had at that point (as a lower bound).
+ *
+ * run_load_sweep runs with increasing rates to find the saturation point,
+ * i.e. the highest rate at which the completed calls keep up with the
+ * schedule (and the p99 latency is within max_p99, if given).
+ *
+ * With several workers, the job is called concurrently, and must be
+ * thread-safe. The workers share the time-stamp counter, which should
+ * be invariant and synchronized across cores (as on recent x86).
+ *
+ * @author Dahua Lin
+ */
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#ifndef LIGHT_TEST_LOAD_BENCHMARK_H_
+#define LIGHT_TEST_LOAD_BENCHMARK_H_
+
+#include "benchmark.h"
+#include "latency_histogram.h"
+#include "prng.h"
+
+#include <chrono>
+#include <cmath>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace ltest
+{
+
+#define _LTEST_DEFINE_LOAD_OPTION_FIELD(T, name) \
+		T name; \
+		load_option& set_##name(T v) { \
+			name = v; \
+			return *this; }
+
+	struct load_option
+	{
+		_LTEST_DEFINE_LOAD_OPTION_FIELD( double, rate )			// offered calls per second
+		_LTEST_DEFINE_LOAD_OPTION_FIELD( double, duration )		// seconds of recorded schedule
+		_LTEST_DEFINE_LOAD_OPTION_FIELD( double, warmup )		// seconds of schedule before that
+		_LTEST_DEFINE_LOAD_OPTION_FIELD( double, max_warming_time )	// of the back-to-back warmup (0: none)
+		_LTEST_DEFINE_LOAD_OPTION_FIELD( unsigned int, num_threads )
+		_LTEST_DEFINE_LOAD_OPTION_FIELD( bool, poisson )		// Poisson arrivals, or evenly spaced
+		_LTEST_DEFINE_LOAD_OPTION_FIELD( uint64_t, seed )
+		_LTEST_DEFINE_LOAD_OPTION_FIELD( double, growth )		// the ratio of rates in a sweep
+		_LTEST_DEFINE_LOAD_OPTION_FIELD( size_t, max_steps )
+		_LTEST_DEFINE_LOAD_OPTION_FIELD( double, keep_up )		// the least achieved / offered rate
+		_LTEST_DEFINE_LOAD_OPTION_FIELD( double, max_p99 )		// in seconds (0: no bound)
+
+		explicit load_option(double rate_)
+		: rate(rate_)
+		, duration(1.0)
+		, warmup(0.1)
+		, max_warming_time(0.25)
+		, num_threads(1)
+		, poisson(true)
+		, seed(0)
+		, growth(1.5)
+		, max_steps(20)
+		, keep_up(0.95)
+		, max_p99(0.0)
+		{ }
+	};
+
+
+	/**
+	 * The results of a run, which are passed to the monitor as a
+	 * fourth argument. The histograms are in cycle_clock ticks.
+	 */
+	struct load_result
+	{
+		double offered_rate;	// scheduled calls per second
+		double achieved_rate;	// completed calls per second
+		size_t missed;			// the calls not made before the end
+		latency_histogram latency;	// from the intended start
+		latency_histogram service;	// from the actual start
+
+		explicit load_result(double unit_nsecs)
+		: offered_rate(0), achieved_rate(0), missed(0)
+		, latency(unit_nsecs), service(unit_nsecs)
+		{
+		}
+	};
+
+
+	namespace detail
+	{
+		typedef cycle_clock::tick_type tick_t;
+
+		// the part of a schedule made by one worker
+		struct load_worker_state
+		{
+			latency_histogram latency;
+			latency_histogram service;
+			size_t completed;
+			size_t missed;
+			tick_t last_end;
+
+			explicit load_worker_state(double unit_nsecs)
+			: latency(unit_nsecs), service(unit_nsecs)
+			, completed(0), missed(0), last_end(0)
+			{
+			}
+		};
+
+		// waits until t, sleeping while it is far ahead (leaving a margin
+		// of 1 ms for the sleep to overshoot, which would delay the call)
+		inline void wait_until_tick(tick_t t, double tpn)
+		{
+			const tick_t spin = (tick_t)(1.0e6 / tpn);
+			tick_t now;
+			while ((now = cycle_clock::now()) < t)
+			{
+				if (t - now > 2 * spin)
+				{
+					std::this_thread::sleep_for(std::chrono::nanoseconds((long long)(double(t - now - spin) * tpn)));
+				}
+				else
+				{
+					std::this_thread::yield();
+				}
+			}
+		}
+
+		template<class Job>
+		inline void run_load_worker(const Job& job, const load_option& option, unsigned int w,
+				tick_t t0, tick_t rec_begin, tick_t sched_end, tick_t cutoff, double tpn,
+				load_worker_state& s)
+		{
+			const double nt = double(option.num_threads);
+			const double ticks_per_sec = 1.0e9 / tpn;
+			const double mean_gap = ticks_per_sec * nt / option.rate;
+
+			xoshiro256ss rng(splitmix64(option.seed + w));
+			auto gap = [&]()
+			{
+				return option.poisson ? -std::log(1.0 - rng.next_double()) * mean_gap : mean_gap;
+			};
+
+			// the first intended start of this worker
+			double t = double(t0) + (option.poisson ? gap() : ticks_per_sec * double(w) / option.rate);
+
+			for (; (tick_t)t < sched_end; t += gap())
+			{
+				const tick_t intended = (tick_t)t;
+				const bool recorded = intended >= rec_begin;
+
+				wait_until_tick(intended, tpn);
+				tick_t a = cycle_clock::now();
+
+				if (a >= cutoff)
+				{
+					// the calls that are no longer made
+					for (; (tick_t)t < sched_end; t += gap())
+					{
+						if ((tick_t)t >= rec_begin)
+						{
+							s.latency.add(a - (tick_t)t);
+							++ s.missed;
+						}
+					}
+					break;
+				}
+
+				job();
+				tick_t b = cycle_clock::now();
+
+				if (recorded)
+				{
+					s.latency.add(b - intended);
+					s.service.add(b - a);
+					++ s.completed;
+					s.last_end = b;
+				}
+			}
+		}
+	}
+
+
+	/**
+	 * Runs the job on the schedule of the option, and reports it to
+	 * the monitor as mon(job, n, span, result) (or mon(job, n, span)),
+	 * where n is the number of completed calls, and span the recorded
+	 * part of the schedule (until the last completion). It throws
+	 * std::invalid_argument unless option.rate > 0 and option.duration > 0.
+	 */
+	template<class Job, class Monitor>
+	inline load_result run_load_benchmark(const Job& job, Monitor& mon, const load_option& option)
+	{
+		if (!(option.rate > 0))
+			throw std::invalid_argument("run_load_benchmark: rate > 0 is required.");
+		if (!(option.duration > 0))
+			throw std::invalid_argument("run_load_benchmark: duration > 0 is required.");
+
+		typedef detail::tick_t tick_t;
+
+		const double tpn = cycle_clock::nsecs_per_tick();
+		const double ticks_per_sec = 1.0e9 / tpn;
+		const unsigned int nt = option.num_threads > 0 ? option.num_threads : 1;
+
+		load_option opt(option);
+		opt.num_threads = nt;
+
+		// warming until steady, with batches sized as for a benchmark
+		// of the recorded duration
+
+		if (option.max_warming_time > 0)
+		{
+			auto batch = [&](size_t n, timer& tm)
+			{
+				tm.start();
+				for (size_t i = 0; i < n; ++i) job();
+				return tm.elapsed_secs();
+			};
+			benchmark_option wopt(1);
+			wopt.time_thres = option.duration;
+			wopt.max_warming_time = option.max_warming_time;
+			bench_stats st;
+			detail::warm_up_bench(wopt, batch, st);
+		}
+
+		// leave time to start the threads
+		const tick_t t0 = cycle_clock::now() + (tick_t)(1.0e-3 * ticks_per_sec);
+		const tick_t rec_begin = t0 + (tick_t)(option.warmup * ticks_per_sec);
+		const tick_t sched_end = rec_begin + (tick_t)(option.duration * ticks_per_sec);
+		const tick_t cutoff = rec_begin + (tick_t)(2.0 * option.duration * ticks_per_sec);
+
+		std::vector<detail::load_worker_state> states(nt, detail::load_worker_state(tpn));
+		std::vector<std::thread> threads;
+		for (unsigned int w = 1; w < nt; ++w)
+		{
+			threads.push_back(std::thread(&detail::run_load_worker<Job>, std::cref(job), std::cref(opt), w,
+					t0, rec_begin, sched_end, cutoff, tpn, std::ref(states[w])));
+		}
+		detail::run_load_worker(job, opt, 0, t0, rec_begin, sched_end, cutoff, tpn, states[0]);
+		for (size_t i = 0; i < threads.size(); ++i) threads[i].join();
+
+		load_result r(tpn);
+		size_t completed = 0;
+		tick_t last_end = sched_end;
+		for (unsigned int w = 0; w < nt; ++w)
+		{
+			r.latency.merge(states[w].latency);
+			r.service.merge(states[w].service);
+			completed += states[w].completed;
+			r.missed += states[w].missed;
+			if (states[w].last_end > last_end) last_end = states[w].last_end;
+		}
+
+		const double span_secs = double(last_end - rec_begin) / ticks_per_sec;
+		r.offered_rate = double(completed + r.missed) / option.duration;
+		r.achieved_rate = double(completed) / span_secs;
+
+		detail::report_with(mon, job, completed, runtime_span::from_secs(span_secs), r, 0);
+		return r;
+	}
+
+
+	/**
+	 * Runs at the rates option.rate * growth^k (k = 0, 1, ...), until
+	 * the job cannot keep up, or max_steps runs. Returns the highest
+	 * rate that was kept up with (0 if none). It throws
+	 * std::invalid_argument unless option.rate > 0, option.duration > 0
+	 * and option.growth > 1.
+	 */
+	template<class Job, class Monitor>
+	inline double run_load_sweep(const Job& job, Monitor& mon, const load_option& option)
+	{
+		if (!(option.rate > 0))
+			throw std::invalid_argument("run_load_sweep: rate > 0 is required.");
+		if (!(option.duration > 0))
+			throw std::invalid_argument("run_load_sweep: duration > 0 is required.");
+		if (!(option.growth > 1))
+			throw std::invalid_argument("run_load_sweep: growth > 1 is required.");
+
+		load_option opt(option);
+		double sustained = 0.0;
+
+		for (size_t k = 0; k < option.max_steps; ++k)
+		{
+			load_result r = run_load_benchmark(job, mon, opt);
+
+			bool kept_up = r.missed == 0 && r.achieved_rate >= option.keep_up * r.offered_rate;
+			if (kept_up && option.max_p99 > 0)
+				kept_up = r.latency.nsecs_at(0.99) <= option.max_p99 * 1.0e9;
+			if (!kept_up) break;
+
+			sustained = opt.rate;
+			opt.rate *= option.growth;
+		}
+		return sustained;
+	}
+
+}
+
+#endif /* LOAD_BENCHMARK_H_ */
@@ -0,0 +1,289 @@
+/**
+ * @file mismatch_report.h
+ *
+ * Diagnostics of failed vector/matrix comparisons
+ *
+ * These functions are only invoked after a comparison has failed,
+ * so they do not affect the cost of passing assertions.
+ *
+ * @author Dahua Lin
+ */
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#ifndef LIGHT_TEST_MISMATCH_REPORT_H_
+#define LIGHT_TEST_MISMATCH_REPORT_H_
+
+#include "base.h"
+#include "str_template.h"
+#include "float_accuracy.h"
+#include "tolerance.h"
+
+#include <cmath>
+#include <limits>
+#include <sstream>
+#include <type_traits>
+
+// the maximum number of mismatching elements listed in a report
+#ifndef LTEST_MISMATCH_LIST_SIZE
+#define LTEST_MISMATCH_LIST_SIZE 5
+#endif
+
+namespace ltest
+{
+	namespace detail
+	{
+		template<typename T, bool IsArith=std::is_arithmetic<T>::value>
+		struct mismatch_value
+		{
+			static const bool is_numeric = false;
+
+			static std::string str(const T& ) { return "?"; }
+
+			static double num(const T& ) { return 0.0; }
+		};
+
+		template<typename T>
+		struct mismatch_value<T, true>
+		{
+			static const bool is_numeric = true;
+
+			static std::string str(const T& v)
+			{
+				std::ostringstream oss;
+				oss.precision(std::numeric_limits<T>::max_digits10);
+				oss << v;
+				return oss.str();
+			}
+
+			static double num(const T& v) { return static_cast<double>(v); }
+		};
+	}
+
+
+	class mismatch_report
+	{
+	public:
+		mismatch_report(size_t nchecked, bool is_matrix, size_t max_listed = LTEST_MISMATCH_LIST_SIZE)
+		: m_max_listed(max_listed)
+		, m_nchecked(nchecked), m_count(0), m_nnum(0), m_nnan(0)
+		, m_max_err(0.0), m_max_i(0), m_max_j(0)
+		, m_is_matrix(is_matrix)
+		{
+		}
+
+		size_t count() const
+		{
+			return m_count;
+		}
+
+		double max_abs_error() const
+		{
+			return m_max_err;
+		}
+
+		template<typename A, typename B>
+		void add(size_t i, size_t j, const A& a, const B& b)
+		{
+			typedef detail::mismatch_value<A> va;
+			typedef detail::mismatch_value<B> vb;
+
+			++ m_count;
+
+			double err = 0.0;
+			double rel = 0.0;
+			bool numeric = va::is_numeric && vb::is_numeric;
+
+			if (numeric)
+			{
+				++ m_nnum;
+
+				double x = va::num(a);
+				double y = vb::num(b);
+				err = std::fabs(x - y);
+
+				double s = std::fabs(x) > std::fabs(y) ? std::fabs(x) : std::fabs(y);
+				rel = s > 0.0 ? err / s : 0.0;
+
+				if (err != err)
+				{
+					++ m_nnan;
+				}
+				else if (err > m_max_err || m_nnum == m_nnan + 1)
+				{
+					m_max_err = err;
+					m_max_i = i;
+					m_max_j = j;
+				}
+			}
+
+			if (m_count <= m_max_listed)
+			{
+				m_lines += "\n        ";
+				m_lines += index_str(i, j);
+				m_lines += ": ";
+				m_lines += va::str(a);
+				m_lines += " vs ";
+				m_lines += vb::str(b);
+				if (numeric)
+				{
+					m_lines += sformat(err, "  (abs err = %.4g");
+					m_lines += sformat(rel, ", rel err = %.4g)");
+				}
+			}
+		}
+
+		std::string str() const
+		{
+			std::string s = sformat(m_count, "      %lu");
+			s += sformat(m_nchecked, " of %lu elements mismatch");
+
+			if (m_nnum > m_nnan)
+			{
+				s += sformat(m_max_err, ", max abs err = %.4g at ");
+				s += index_str(m_max_i, m_max_j);
+			}
+			if (m_nnan > 0)
+			{
+				s += sformat(m_nnan, ", %lu involving NaN");
+			}
+			s += m_lines;
+
+			if (m_count > m_max_listed)
+			{
+				s += sformat(m_count - m_max_listed, "\n        ... (%lu more)");
+			}
+			return s;
+		}
+
+	private:
+		std::string index_str(size_t i, size_t j) const
+		{
+			return m_is_matrix ?
+					sformat(i, "[%lu, ") + sformat(j, "%lu]") :
+					sformat(i, "[%lu]");
+		}
+
+	private:
+		size_t m_max_listed;
+		size_t m_nchecked;
+		size_t m_count;
+		size_t m_nnum;
+		size_t m_nnan;
+		double m_max_err;
+		size_t m_max_i;
+		size_t m_max_j;
+		bool m_is_matrix;
+		std::string m_lines;
+
+	}; // end class mismatch_report
+
+
+	/************************************************
+	 *
+	 *  Collecting mismatches
+	 *
+	 ************************************************/
+
+	template<typename TInt, class VecA, class VecB>
+	inline mismatch_report vector_mismatches(TInt n, const VecA& a, const VecB& b)
+	{
+		mismatch_report r((size_t)n, false);
+		for (TInt i = 0; i < n; ++i)
+		{
+			if (!(a[i] == b[i])) r.add((size_t)i, 0, a[i], b[i]);
+		}
+		return r;
+	}
+
+	template<typename TInt, class VecA, class VecB, typename Tol>
+	inline mismatch_report vector_mismatches(TInt n, const VecA& a, const VecB& b, const Tol& tol)
+	{
+		typedef typename std::decay<decltype(a[0] - b[0])>::type T;
+		typedef typename detail::tol_kernel<T, Tol>::value_type V;
+		typename detail::tol_kernel<T, Tol>::type k = detail::bind_tol<T>(tol);
+
+		mismatch_report r((size_t)n, false);
+		for (TInt i = 0; i < n; ++i)
+		{
+			if (!k(static_cast<V>(a[i]), static_cast<V>(b[i]))) r.add((size_t)i, 0, a[i], b[i]);
+		}
+		return r;
+	}
+
+	template<typename TInt, class VecA, typename T>
+	inline mismatch_report vector_value_mismatches(TInt n, const VecA& a, const T& v)
+	{
+		mismatch_report r((size_t)n, false);
+		for (TInt i = 0; i < n; ++i)
+		{
+			if (!(a[i] == v)) r.add((size_t)i, 0, a[i], v);
+		}
+		return r;
+	}
+
+	template<typename TInt, typename T, typename TTol>
+	inline std::string vector_ulp_mismatches(TInt n, const T *a, const T *b, TTol dtol)
+	{
+		mismatch_report r((size_t)n, false);
+		uint64_t dmax = 0;
+		for (TInt i = 0; i < n; ++i)
+		{
+			uint64_t d = ulp_diff(a[i], b[i]);
+			if (d > dmax) dmax = d;
+			if (d > (uint64_t)dtol) r.add((size_t)i, 0, a[i], b[i]);
+		}
+		return sformat((unsigned long long)dmax, "      max ULP distance = %llu\n") + r.str();
+	}
+
+	template<typename TInt, class MatA, class MatB>
+	inline mismatch_report matrix_mismatches(TInt m, TInt n, const MatA& a, const MatB& b)
+	{
+		mismatch_report r((size_t)m * (size_t)n, true);
+		for (TInt j = 0; j < n; ++j)
+		{
+			for (TInt i = 0; i < m; ++i)
+			{
+				if (!( a(i, j) == b(i, j) )) r.add((size_t)i, (size_t)j, a(i, j), b(i, j));
+			}
+		}
+		return r;
+	}
+
+	template<typename TInt, class MatA, class MatB, typename Tol>
+	inline mismatch_report matrix_mismatches(TInt m, TInt n, const MatA& a, const MatB& b, const Tol& tol)
+	{
+		typedef typename std::decay<decltype(a(0, 0) - b(0, 0))>::type T;
+		typedef typename detail::tol_kernel<T, Tol>::value_type V;
+		typename detail::tol_kernel<T, Tol>::type k = detail::bind_tol<T>(tol);
+
+		mismatch_report r((size_t)m * (size_t)n, true);
+		for (TInt j = 0; j < n; ++j)
+		{
+			for (TInt i = 0; i < m; ++i)
+			{
+				if (!k(static_cast<V>(a(i, j)), static_cast<V>(b(i, j)))) r.add((size_t)i, (size_t)j, a(i, j), b(i, j));
+			}
+		}
+		return r;
+	}
+
+	template<typename TInt, class MatA, typename T>
+	inline mismatch_report matrix_value_mismatches(TInt m, TInt n, const MatA& a, const T& v)
+	{
+		mismatch_report r((size_t)m * (size_t)n, true);
+		for (TInt j = 0; j < n; ++j)
+		{
+			for (TInt i = 0; i < m; ++i)
+			{
+				if (!( a(i, j) == v )) r.add((size_t)i, (size_t)j, a(i, j), v);
+			}
+		}
+		return r;
+	}
+
+}
+
+#endif /* MISMATCH_REPORT_H_ */
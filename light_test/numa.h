@@ -0,0 +1,333 @@
+/**
+ * @file numa.h
+ *
+ * @brief Placement of benchmarks on NUMA nodes
+ *
+ * The topology is read from /sys/devices/system/node, the running thread
+ * is bound to the CPUs of a node by sched_setaffinity, and memory is bound
+ * to a node by the set_mempolicy and mbind system calls (so that libnuma
+ * is not needed). Where these are not available (other systems, or
+ * kernels without NUMA support), there is one node, and binding does
+ * nothing (the binding functions return false).
+ *
+ * - numa_scope binds the current thread (its CPUs, and the memory it
+ *   allocates) for its lifetime, as done by run_benchmark for the
+ *   cpu_node and mem_node of benchmark_option.
+ * - numa_array allocates a buffer on a node.
+ * - run_numa_sweep (in numa_sweep.h) runs a job for every pair of CPU
+ *   node and memory node, and compares local and remote throughput.
+ *
+ * @author Dahua Lin
+ */
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#ifndef LIGHT_TEST_NUMA_H_
+#define LIGHT_TEST_NUMA_H_
+
+#include "base.h"
+#include "str_template.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <vector>
+
+#if defined(__linux__)
+#define LTEST_HAS_NUMA
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace ltest
+{
+
+	namespace detail
+	{
+		// the numbers in a list such as "0-3,8-11"
+		inline std::vector<int> parse_id_list(const char *s)
+		{
+			std::vector<int> r;
+			while (*s)
+			{
+				char *e;
+				long a = std::strtol(s, &e, 10);
+				if (e == s) break;
+				long b = a;
+				s = e;
+				if (*s == '-')
+				{
+					b = std::strtol(s + 1, &e, 10);
+					s = e;
+				}
+				for (long i = a; i <= b; ++i) r.push_back((int)i);
+				while (*s == ',' || *s == '\n' || *s == ' ') ++s;
+			}
+			return r;
+		}
+
+		inline std::string read_first_line(const std::string& path)
+		{
+			std::string r;
+			std::FILE *f = std::fopen(path.c_str(), "r");
+			if (f)
+			{
+				char buf[4096];
+				if (std::fgets(buf, sizeof(buf), f)) r = buf;
+				std::fclose(f);
+			}
+			return r;
+		}
+
+#ifdef LTEST_HAS_NUMA
+		// the constants of <numaif.h>
+		const int mpol_default = 0;
+		const int mpol_bind = 2;
+		const unsigned int mpol_mf_move = 2;
+
+		// a mask of nodes, as taken by the system calls
+		struct node_mask
+		{
+			static const size_t nbits = 1024;
+			unsigned long bits[nbits / (8 * sizeof(unsigned long))];
+
+			// whether a node fits in the mask
+			static bool holds(int node)
+			{
+				return node >= 0 && (size_t)node < nbits;
+			}
+
+			// node should satisfy holds(node)
+			explicit node_mask(int node)
+			{
+				std::memset(bits, 0, sizeof(bits));
+				const size_t w = 8 * sizeof(unsigned long);
+				bits[(size_t)node / w] |= 1UL << ((size_t)node % w);
+			}
+		};
+#endif
+	}
+
+
+	// the number of NUMA nodes (1 where unknown)
+	inline int numa_num_nodes()
+	{
+		static const int n = []()
+		{
+			std::vector<int> ids = detail::parse_id_list(
+					detail::read_first_line("/sys/devices/system/node/online").c_str());
+			int m = 0;
+			for (size_t i = 0; i < ids.size(); ++i) if (ids[i] + 1 > m) m = ids[i] + 1;
+			return m > 0 ? m : 1;
+		}();
+		return n;
+	}
+
+	// the CPUs of a node (empty where unknown)
+	inline std::vector<int> numa_node_cpus(int node)
+	{
+		return detail::parse_id_list(detail::read_first_line(
+				sformat(node, "/sys/devices/system/node/node%d/cpulist")).c_str());
+	}
+
+	// binds the current thread to the CPUs of a node
+	inline bool bind_thread_to_numa_node(int node)
+	{
+#ifdef LTEST_HAS_NUMA
+		std::vector<int> cpus = numa_node_cpus(node);
+		if (cpus.empty()) return false;
+
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		for (size_t i = 0; i < cpus.size(); ++i)
+		{
+			if (cpus[i] < 0 || cpus[i] >= CPU_SETSIZE) return false;
+			CPU_SET(cpus[i], &set);
+		}
+		return ::sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+		return false;
+#endif
+	}
+
+	/**
+	 * Makes the memory that the current thread allocates (i.e. touches
+	 * first) come from a node, or, with node < 0, restores the default
+	 * policy (of allocating on the node of the touching CPU)
+	 */
+	inline bool set_thread_memory_node(int node)
+	{
+#ifdef LTEST_HAS_NUMA
+		if (node < 0) return ::syscall(SYS_set_mempolicy, detail::mpol_default, 0, 0) == 0;
+		if (!detail::node_mask::holds(node)) return false;
+
+		detail::node_mask mask(node);
+		return ::syscall(SYS_set_mempolicy, detail::mpol_bind, mask.bits, detail::node_mask::nbits) == 0;
+#else
+		return false;
+#endif
+	}
+
+	/**
+	 * Binds the pages of a buffer to a node, moving those that are
+	 * already allocated (the buffer should be page-aligned)
+	 */
+	inline bool bind_memory_to_numa_node(void *p, size_t bytes, int node)
+	{
+#ifdef LTEST_HAS_NUMA
+		if (!detail::node_mask::holds(node)) return false;
+
+		detail::node_mask mask(node);
+		return ::syscall(SYS_mbind, p, bytes, detail::mpol_bind, mask.bits, detail::node_mask::nbits,
+				detail::mpol_mf_move) == 0;
+#else
+		return false;
+#endif
+	}
+
+
+	/**
+	 * Binds the current thread to the CPUs of cpu_node, and its new
+	 * memory to mem_node (either can be < 0, to leave it unchanged),
+	 * until the end of the scope. Then the CPUs are restored, and the
+	 * memory policy is reset to the default.
+	 */
+	class numa_scope
+	{
+	public:
+		numa_scope(int cpu_node, int mem_node)
+		: m_cpu_bound(false), m_mem_bound(false)
+		{
+#ifdef LTEST_HAS_NUMA
+			if (cpu_node >= 0 && ::sched_getaffinity(0, sizeof(m_old_cpus), &m_old_cpus) == 0)
+			{
+				m_cpu_bound = bind_thread_to_numa_node(cpu_node);
+			}
+#endif
+			if (mem_node >= 0) m_mem_bound = set_thread_memory_node(mem_node);
+		}
+
+		~numa_scope()
+		{
+#ifdef LTEST_HAS_NUMA
+			if (m_cpu_bound) ::sched_setaffinity(0, sizeof(m_old_cpus), &m_old_cpus);
+#endif
+			if (m_mem_bound) set_thread_memory_node(-1);
+		}
+
+		bool cpu_bound() const
+		{
+			return m_cpu_bound;
+		}
+
+		bool mem_bound() const
+		{
+			return m_mem_bound;
+		}
+
+	private:
+		numa_scope(const numa_scope& );
+		numa_scope& operator = (const numa_scope& );
+
+		bool m_cpu_bound;
+		bool m_mem_bound;
+#ifdef LTEST_HAS_NUMA
+		cpu_set_t m_old_cpus;
+#endif
+	};
+
+
+	/**
+	 * An array of n value-initialized elements, whose pages are bound
+	 * to a node (node < 0: wherever they are first touched). The memory
+	 * is mapped directly, so that no page is shared with other data.
+	 */
+	template<typename T>
+	class numa_array
+	{
+	public:
+		numa_array(size_t n, int node)
+		: m_data(0), m_size(n), m_bytes(n * sizeof(T)), m_bound(false)
+		{
+#ifdef LTEST_HAS_NUMA
+			if (m_bytes > 0)
+			{
+				void *p = ::mmap(0, m_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+				if (p == MAP_FAILED) throw std::bad_alloc();
+				if (node >= 0) m_bound = bind_memory_to_numa_node(p, m_bytes, node);
+				m_data = static_cast<T*>(p);
+			}
+			for (size_t i = 0; i < n; ++i) new (m_data + i) T();
+#else
+			m_data = new T[n]();
+#endif
+		}
+
+		numa_array(numa_array&& other)
+		: m_data(other.m_data), m_size(other.m_size), m_bytes(other.m_bytes), m_bound(other.m_bound)
+		{
+			other.m_data = 0;
+			other.m_size = 0;
+			other.m_bytes = 0;
+		}
+
+		~numa_array()
+		{
+#ifdef LTEST_HAS_NUMA
+			for (size_t i = 0; i < m_size; ++i) m_data[i].~T();
+			if (m_data) ::munmap(m_data, m_bytes);
+#else
+			delete [] m_data;
+#endif
+		}
+
+		// whether the pages are bound to the requested node
+		bool is_bound() const
+		{
+			return m_bound;
+		}
+
+		size_t size() const
+		{
+			return m_size;
+		}
+
+		T *data()
+		{
+			return m_data;
+		}
+
+		const T *data() const
+		{
+			return m_data;
+		}
+
+		T& operator[] (size_t i)
+		{
+			return m_data[i];
+		}
+
+		const T& operator[] (size_t i) const
+		{
+			return m_data[i];
+		}
+
+	private:
+		numa_array(const numa_array& );
+		numa_array& operator = (const numa_array& );
+
+		T *m_data;
+		size_t m_size;
+		size_t m_bytes;
+		bool m_bound;
+	};
+
+}
+
+#endif /* NUMA_H_ */
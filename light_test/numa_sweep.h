@@ -0,0 +1,224 @@
+/**
+ * @file numa_sweep.h
+ *
+ * @brief Local versus remote memory throughput of a job
+ *
+ * run_numa_sweep benchmarks a job for every pair of a CPU node and a
+ * memory node: the job is made by a factory while the memory policy of
+ * the thread is bound to the memory node (so that the buffers it touches
+ * first are placed there), and is run with the thread bound to the CPU
+ * node. Each run is reported to the monitor as "name [cpu c, mem m]".
+ * On a single-node machine, only the local run is made. On several
+ * nodes, a placement whose CPU or memory binding fails (e.g. an offline
+ * node, or one without CPUs) is skipped, and has no rate in the result.
+ *
+ * @author Dahua Lin
+ */
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#ifndef LIGHT_TEST_NUMA_SWEEP_H_
+#define LIGHT_TEST_NUMA_SWEEP_H_
+
+#include "benchmark.h"
+#include "roofline.h"
+#include "numa.h"
+
+#include <cmath>
+#include <limits>
+#include <string>
+#include <vector>
+
+namespace ltest
+{
+
+	/**
+	 * The throughput (in elements per second) of every placement
+	 */
+	class numa_sweep_result
+	{
+	public:
+		explicit numa_sweep_result(int nodes)
+		: m_nodes(nodes), m_rates((size_t)(nodes * nodes), std::numeric_limits<double>::quiet_NaN())
+		{
+		}
+
+		int num_nodes() const
+		{
+			return m_nodes;
+		}
+
+		// NaN for a placement that was skipped
+		double rate(int cpu_node, int mem_node) const
+		{
+			return m_rates[(size_t)(cpu_node * m_nodes + mem_node)];
+		}
+
+		bool is_placed(int cpu_node, int mem_node) const
+		{
+			return !std::isnan(rate(cpu_node, mem_node));
+		}
+
+		void set_rate(int cpu_node, int mem_node, double r)
+		{
+			m_rates[(size_t)(cpu_node * m_nodes + mem_node)] = r;
+		}
+
+		// the mean over the placements made with cpu_node == mem_node
+		// (0 if none)
+		double local() const
+		{
+			double s = 0.0;
+			int k = 0;
+			for (int c = 0; c < m_nodes; ++c)
+			{
+				if (is_placed(c, c)) { s += rate(c, c); ++k; }
+			}
+			return k > 0 ? s / double(k) : 0.0;
+		}
+
+		// the mean over the other placements made (0 if none, as on a
+		// single node)
+		double remote() const
+		{
+			double s = 0.0;
+			int k = 0;
+			for (int c = 0; c < m_nodes; ++c)
+			{
+				for (int m = 0; m < m_nodes; ++m)
+				{
+					if (m != c && is_placed(c, m)) { s += rate(c, m); ++k; }
+				}
+			}
+			return k > 0 ? s / double(k) : 0.0;
+		}
+
+	private:
+		int m_nodes;
+		std::vector<double> m_rates;
+	};
+
+
+	namespace detail
+	{
+		// a job reported under the name of its placement
+		template<class Job>
+		class numa_placed_job
+		{
+		public:
+			numa_placed_job(const Job& job, int cpu_node, int mem_node)
+			: m_job(job)
+			, m_name(std::string(job.name()) + sformat(cpu_node, " [cpu %d") + sformat(mem_node, ", mem %d]"))
+			{
+			}
+
+			const char *name() const
+			{
+				return m_name.c_str();
+			}
+
+			size_t size() const
+			{
+				return m_job.size();
+			}
+
+			double bytes_read() const
+			{
+				return job_bytes_read(m_job, 0);
+			}
+
+			double bytes_written() const
+			{
+				return job_bytes_written(m_job, 0);
+			}
+
+			double flops() const
+			{
+				return job_flops(m_job, 0);
+			}
+
+			void operator() () const
+			{
+				m_job();
+			}
+
+		private:
+			const Job& m_job;
+			std::string m_name;
+		};
+
+		// records the throughput of a run, and passes it on
+		template<class Monitor>
+		class numa_sweep_monitor
+		{
+		public:
+			numa_sweep_monitor(Monitor& mon, numa_sweep_result& r, int cpu_node, int mem_node)
+			: m_mon(mon), m_result(r), m_cpu_node(cpu_node), m_mem_node(mem_node)
+			{
+			}
+
+			template<class Job>
+			void operator() (const Job& job, size_t n, const runtime_span& span, const bench_stats& st)
+			{
+				m_result.set_rate(m_cpu_node, m_mem_node, span.ps(n * job.size()));
+				report_with(m_mon, job, n, span, st, 0);
+			}
+
+		private:
+			Monitor& m_mon;
+			numa_sweep_result& m_result;
+			int m_cpu_node;
+			int m_mem_node;
+		};
+
+		// whether the thread can be bound to the CPUs of cpu_node and
+		// its memory to mem_node
+		inline bool can_place_on_numa_nodes(int cpu_node, int mem_node)
+		{
+			numa_scope probe(cpu_node, mem_node);
+			return probe.cpu_bound() && probe.mem_bound();
+		}
+
+		template<class Factory>
+		inline auto make_job_on_node(Factory& make_job, int mem_node) -> decltype(make_job())
+		{
+			numa_scope placement(-1, mem_node);
+			return make_job();
+		}
+	}
+
+
+	/**
+	 * make_job() gives a job that owns its buffers (allocating and
+	 * initializing them), and the runs are made with the option
+	 * (whose cpu_node and mem_node are set for each placement)
+	 */
+	template<class Factory, class Monitor>
+	inline numa_sweep_result run_numa_sweep(Factory make_job, Monitor& mon, const benchmark_option& option)
+	{
+		const int nn = numa_num_nodes();
+		numa_sweep_result r(nn);
+
+		for (int c = 0; c < nn; ++c)
+		{
+			for (int m = 0; m < nn; ++m)
+			{
+				if (nn > 1 && !detail::can_place_on_numa_nodes(c, m)) continue;
+
+				auto job = detail::make_job_on_node(make_job, m);
+				detail::numa_placed_job<decltype(job)> pjob(job, c, m);
+				detail::numa_sweep_monitor<Monitor> smon(mon, r, c, m);
+
+				benchmark_option opt(option);
+				opt.set_cpu_node(c).set_mem_node(m);
+				run_benchmark(pjob, smon, opt);
+			}
+		}
+		return r;
+	}
+
+}
+
+#endif /* NUMA_SWEEP_H_ */
@@ -0,0 +1,304 @@
+/**
+ * @file param_tests.h
+ *
+ * Typed and value-parameterized test cases
+ *
+ * - Typed cases: a class template of test cases is instantiated over
+ *   a list of types, and each instantiation is registered as a lazily
+ *   constructed case named "Tmpl [type]" (see ADD_TYPED_TESTCASES).
+ *   The template need not implement name().
+ *
+ * - Value-parameterized cases: a test function taking a parameter is
+ *   run over a table (or a generated sequence) of parameters, and each
+ *   parameter is a case named "Func [i]" (see ADD_PARAM_TESTS).
+ *   The parameters are stored contiguously in one group, which runs
+ *   them through a single case object.
+ *
+ * @author Dahua Lin
+ */
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#ifndef LIGHT_TEST_PARAM_TESTS_H_
+#define LIGHT_TEST_PARAM_TESTS_H_
+
+#include "test_units.h"
+#include "str_template.h"
+
+#include <iterator>
+#include <type_traits>
+#include <typeinfo>
+#include <vector>
+
+namespace ltest
+{
+
+	/************************************************
+	 *
+	 *  Type names and type lists
+	 *
+	 ************************************************/
+
+	/**
+	 * The name of a type shown in the names of typed cases. For types
+	 * without a specialization, the (implementation-defined) name
+	 * given by typeid is used. Use LTEST_DEFINE_TYPE_NAME to give a
+	 * readable name to a user type.
+	 */
+	template<typename T>
+	struct type_name
+	{
+		static const char *get() { return typeid(T).name(); }
+	};
+
+#define LTEST_DEFINE_TYPE_NAME( T ) \
+	namespace ltest { template<> struct type_name< T > { static const char *get() { return #T; } }; }
+
+	template<typename... Ts>
+	struct type_list { };
+
+}
+
+LTEST_DEFINE_TYPE_NAME( bool )
+LTEST_DEFINE_TYPE_NAME( char )
+LTEST_DEFINE_TYPE_NAME( signed char )
+LTEST_DEFINE_TYPE_NAME( unsigned char )
+LTEST_DEFINE_TYPE_NAME( short )
+LTEST_DEFINE_TYPE_NAME( unsigned short )
+LTEST_DEFINE_TYPE_NAME( int )
+LTEST_DEFINE_TYPE_NAME( unsigned int )
+LTEST_DEFINE_TYPE_NAME( long )
+LTEST_DEFINE_TYPE_NAME( unsigned long )
+LTEST_DEFINE_TYPE_NAME( long long )
+LTEST_DEFINE_TYPE_NAME( unsigned long long )
+LTEST_DEFINE_TYPE_NAME( float )
+LTEST_DEFINE_TYPE_NAME( double )
+LTEST_DEFINE_TYPE_NAME( long double )
+
+namespace ltest
+{
+
+	/************************************************
+	 *
+	 *  Typed cases
+	 *
+	 ************************************************/
+
+	namespace detail
+	{
+		// one name per instantiation, which lives as long as the program
+		// (base is only used by the first call, made at registration)
+		template<template<typename> class Tmpl, typename T>
+		inline const char *typed_case_name(const char *base)
+		{
+			static const std::string s = std::string(base ? base : "") + " [" + type_name<T>::get() + "]";
+			return s.c_str();
+		}
+
+		template<template<typename> class Tmpl, typename T>
+		class typed_case : public Tmpl<T>
+		{
+		public:
+			const char *name() const
+			{
+				return typed_case_name<Tmpl, T>(0);
+			}
+		};
+
+		template<template<typename> class Tmpl, typename... Ts>
+		struct typed_cases;
+
+		template<template<typename> class Tmpl>
+		struct typed_cases<Tmpl>
+		{
+			template<class Pack>
+			static void add(Pack& pack, const char *base) { }
+		};
+
+		template<template<typename> class Tmpl, typename T, typename... Ts>
+		struct typed_cases<Tmpl, T, Ts...>
+		{
+			template<class Pack>
+			static void add(Pack& pack, const char *base)
+			{
+				pack.add(typed_case_name<Tmpl, T>(base), &make_test_case< typed_case<Tmpl, T> >);
+				typed_cases<Tmpl, Ts...>::add(pack, base);
+			}
+		};
+
+		template<template<typename> class Tmpl, typename... Ts>
+		struct typed_cases<Tmpl, type_list<Ts...> > : public typed_cases<Tmpl, Ts...>
+		{
+		};
+	}
+
+
+	/************************************************
+	 *
+	 *  Value-parameterized cases
+	 *
+	 ************************************************/
+
+	/**
+	 * The cases func(params[i]) for i = 0, ..., n-1
+	 *
+	 * The name and file strings are not copied, and should be static.
+	 */
+	template<typename P, typename F>
+	class param_case_group : public test_case_group
+	{
+	public:
+		template<typename Iter>
+		param_case_group(const char *name, const char *file, unsigned int line, F func,
+				Iter first, Iter last)
+		: m_name(name), m_file(file), m_line(line), m_func(func)
+		, m_params(first, last), m_case(*this)
+		{
+			init_names();
+		}
+
+		template<typename Gen>
+		param_case_group(const char *name, const char *file, unsigned int line, F func,
+				size_t n, Gen gen)
+		: m_name(name), m_file(file), m_line(line), m_func(func), m_case(*this)
+		{
+			m_params.reserve(n);
+			for (size_t i = 0; i < n; ++i) m_params.push_back(gen(i));
+			init_names();
+		}
+
+		const char *name() const
+		{
+			return m_name;
+		}
+
+		const char *file() const
+		{
+			return m_file;
+		}
+
+		unsigned int line() const
+		{
+			return m_line;
+		}
+
+		const P& param(size_t i) const
+		{
+			return m_params[i];
+		}
+
+		virtual size_t size() const
+		{
+			return m_params.size();
+		}
+
+		virtual const char *case_name(size_t i) const
+		{
+			return m_names.c_str() + m_name_offsets[i];
+		}
+
+		virtual test_case& select(size_t i)
+		{
+			m_case.reset(i);
+			return m_case;
+		}
+
+	private:
+		class param_case : public test_case
+		{
+		public:
+			explicit param_case(param_case_group& g)
+			: m_group(g), m_index(0)
+			{
+			}
+
+			void reset(size_t i)
+			{
+				m_index = i;
+			}
+
+			const char *name() const
+			{
+				return m_group.case_name(m_index);
+			}
+
+			void run()
+			{
+				m_group.m_func(m_group.m_params[m_index]);
+			}
+
+		private:
+			param_case_group& m_group;
+			size_t m_index;
+		};
+
+		// all names are kept in one buffer, separated by '\0'
+		void init_names()
+		{
+			size_t n = m_params.size();
+			m_name_offsets.reserve(n);
+			for (size_t i = 0; i < n; ++i)
+			{
+				m_name_offsets.push_back(m_names.size());
+				m_names += m_name;
+				m_names += sformat(i, " [%lu]");
+				m_names += '\0';
+			}
+		}
+
+		param_case_group(const param_case_group& );
+		param_case_group& operator = (const param_case_group& );
+
+	private:
+		const char *m_name;
+		const char *m_file;
+		unsigned int m_line;
+		F m_func;
+		std::vector<P> m_params;
+		std::string m_names;
+		std::vector<size_t> m_name_offsets;
+		param_case m_case;
+
+	}; // end class param_case_group
+
+
+	// params is an array, or a container with begin() and end()
+
+	template<typename F, class Params>
+	inline test_case_group* make_param_cases(const char *name, const char *file, unsigned int line,
+			F func, const Params& params)
+	{
+		typedef typename std::iterator_traits<decltype(std::begin(params))>::value_type P;
+		return new param_case_group<P, F>(name, file, line, func, std::begin(params), std::end(params));
+	}
+
+	// gen(i) gives the i-th parameter
+
+	template<typename F, class Gen>
+	inline test_case_group* make_param_cases_n(const char *name, const char *file, unsigned int line,
+			F func, size_t n, Gen gen)
+	{
+		typedef typename std::decay<decltype(gen(size_t(0)))>::type P;
+		return new param_case_group<P, F>(name, file, line, func, n, gen);
+	}
+
+}
+
+// to be used within AUTO_TPACK (or with a test_pack), e.g.
+//
+//   ADD_TYPED_TESTCASES( numpair_arith, float, double )
+//   ADD_PARAM_TESTS( test_parse_int, parse_int_table )
+//
+
+#define ADD_TYPED_TESTCASES( Tmpl, ... ) \
+	::ltest::detail::typed_cases< Tmpl, __VA_ARGS__ >::add(*this, #Tmpl);
+
+#define ADD_PARAM_TESTS( Func, Params ) \
+	this->add(::ltest::make_param_cases(#Func, __FILE__, __LINE__, &Func, Params));
+
+#define ADD_PARAM_TESTS_N( Func, N, Gen ) \
+	this->add(::ltest::make_param_cases_n(#Func, __FILE__, __LINE__, &Func, N, Gen));
+
+#endif /* PARAM_TESTS_H_ */
@@ -0,0 +1,119 @@
+/**
+ * @file prng.h
+ *
+ * Small and fast pseudo-random number generators for test inputs
+ *
+ * - splitmix64:   a 64-bit mixing function, used to derive seeds
+ * - xoshiro256ss: the xoshiro256** generator (Blackman & Vigna),
+ *                 which satisfies the standard random engine interface
+ *
+ * @author Dahua Lin
+ */
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#ifndef LIGHT_TEST_PRNG_H_
+#define LIGHT_TEST_PRNG_H_
+
+#include "base.h"
+
+#ifdef LTEST_USE_C11_STDLIB
+#include <cstdint>
+#else
+#include <stdint.h>
+#endif
+
+namespace ltest
+{
+#ifdef LTEST_USE_C11_STDLIB
+	using std::uint32_t;
+	using std::uint64_t;
+#else
+	using ::uint32_t;
+	using ::uint64_t;
+#endif
+
+	inline uint64_t splitmix64(uint64_t x)
+	{
+		x += 0x9e3779b97f4a7c15ULL;
+		x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+		x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+		return x ^ (x >> 31);
+	}
+
+
+	class xoshiro256ss
+	{
+	public:
+		typedef uint64_t result_type;
+
+		static result_type min() { return 0; }
+		static result_type max() { return ~(uint64_t)0; }
+
+	public:
+		explicit xoshiro256ss(uint64_t s = 0)
+		{
+			seed(s);
+		}
+
+		void seed(uint64_t s)
+		{
+			for (int i = 0; i < 4; ++i)
+			{
+				s += 0x9e3779b97f4a7c15ULL;
+				m_s[i] = splitmix64(s);
+			}
+		}
+
+		uint64_t operator() ()
+		{
+			uint64_t r = rotl(m_s[1] * 5, 7) * 9;
+			uint64_t t = m_s[1] << 17;
+
+			m_s[2] ^= m_s[0];
+			m_s[3] ^= m_s[1];
+			m_s[1] ^= m_s[2];
+			m_s[0] ^= m_s[3];
+			m_s[2] ^= t;
+			m_s[3] = rotl(m_s[3], 45);
+
+			return r;
+		}
+
+		// uniform in [0, n), n > 0
+		uint64_t below(uint64_t n)
+		{
+#if defined(__GNUC__) && defined(__SIZEOF_INT128__)
+			__extension__ typedef unsigned __int128 u128_t;
+			return (uint64_t)(((u128_t)(*this)() * n) >> 64);
+#else
+			return (*this)() % n;
+#endif
+		}
+
+		// uniform in [0, 1)
+		double next_double()
+		{
+			return (double)((*this)() >> 11) * (1.0 / 9007199254740992.0);
+		}
+
+		bool next_bool()
+		{
+			return ((*this)() >> 63) != 0;
+		}
+
+	private:
+		static uint64_t rotl(uint64_t x, int k)
+		{
+			return (x << k) | (x >> (64 - k));
+		}
+
+	private:
+		uint64_t m_s[4];
+	};
+
+}
+
+#endif /* PRNG_H_ */
@@ -0,0 +1,82 @@
+/**
+ * @file profiling_test_mon.h
+ *
+ * Testing monitor that profiles selected test cases
+ *
+ * @author Dahua Lin
+ */
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#ifndef LIGHT_TEST_PROFILING_TEST_MON_H_
+#define LIGHT_TEST_PROFILING_TEST_MON_H_
+
+#include "test_units.h"
+#include "test_mon.h"
+#include "test_exec.h"
+#include "sampling_profiler.h"
+
+#include <cstdio>
+#include <stdexcept>
+
+namespace ltest
+{
+
+	/**
+	 * Runs a sampling profiler during the cases selected by a pattern
+	 * (as that of test_filter, e.g. "hashmap.insert*"). The samples of
+	 * all selected cases are accumulated in the profiler, which is
+	 * not owned. To be attached with a composite_test_monitor, e.g.
+	 *
+	 *   sampling_profiler prof;
+	 *   profiling_test_monitor pmon(prof, "hashmap.*");
+	 *   composite_test_monitor mon;
+	 *   mon.add(smon).add(pmon);
+	 *   execute_suite(suite, mon);
+	 *   prof.print_top(std::cout);
+	 */
+	class profiling_test_monitor : public test_monitor
+	{
+	public:
+		profiling_test_monitor(sampling_profiler& prof, const char *pattern)
+		: m_prof(prof), m_filter(pattern), m_pack_selected(false)
+		{
+		}
+
+		virtual void on_pack_begin(const test_pack& tpack)
+		{
+			m_pack_selected = m_filter.select_pack(tpack.name());
+		}
+
+		virtual void on_case_begin(const test_case& tcase)
+		{
+			if (m_pack_selected && m_filter.select_case(tcase.name()))
+			{
+				// the case still runs (unprofiled) if another profiler is running
+				try
+				{
+					m_prof.start();
+				}
+				catch (std::logic_error& e)
+				{
+					std::fprintf(stderr, "%s is not profiled: %s\n", tcase.name(), e.what());
+				}
+			}
+		}
+
+		virtual void on_case_end(const test_case& tcase, bool is_passed)
+		{
+			m_prof.stop();
+		}
+
+	private:
+		sampling_profiler& m_prof;
+		test_filter m_filter;
+		bool m_pack_selected;
+	};
+
+}
+
+#endif /* PROFILING_TEST_MON_H_ */
@@ -0,0 +1,725 @@
+/**
+ * @file property.h
+ *
+ * Property-based testing: a property is checked over random inputs
+ * drawn from generators, and a counterexample is shrunk on failure
+ *
+ * A property is a function taking one argument per generator, which
+ * fails by returning false or by throwing (e.g. via ASSERT_*). EXPECT_*
+ * checks do not falsify a property, their failures are discarded on
+ * every thread, including the calling one (which runs trials as well).
+ *
+ * The trials are split into chunks of LTEST_PROPERTY_CHUNK_SIZE, each
+ * with its own generator state seeded from (seed, chunk index), and
+ * the chunks are distributed over threads. The earliest failing trial
+ * is always the one reported, so the result of a run only depends on
+ * the seed. The seed is derived from the property name, unless it is
+ * given by the LTEST_SEED environment variable.
+ *
+ * @author Dahua Lin
+ */
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#ifndef LIGHT_TEST_PROPERTY_H_
+#define LIGHT_TEST_PROPERTY_H_
+
+#include "test_assertions.h"
+#include "expectations.h"
+#include "test_units.h"
+#include "prng.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <limits>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+// the number of trials in a chunk (the unit of work of a thread)
+#ifndef LTEST_PROPERTY_CHUNK_SIZE
+#define LTEST_PROPERTY_CHUNK_SIZE 64
+#endif
+
+// the maximum number of successful shrinking steps
+#ifndef LTEST_PROPERTY_MAX_SHRINKS
+#define LTEST_PROPERTY_MAX_SHRINKS 1000
+#endif
+
+namespace ltest
+{
+
+	/************************************************
+	 *
+	 *  Generators
+	 *
+	 *  A generator G provides:
+	 *
+	 *  - typedef ... value_type;
+	 *  - value_type operator() (xoshiro256ss& rng) const;
+	 *  - void shrink(const value_type& v, std::vector<value_type>& out) const;
+	 *    which appends "smaller" candidates of v, the most
+	 *    aggressive ones first.
+	 *
+	 *  Edge values (bounds, zero, ...) are drawn with a
+	 *  probability of 1/8.
+	 *
+	 ************************************************/
+
+	template<typename T>
+	class int_gen
+	{
+	public:
+		typedef T value_type;
+
+		int_gen(T lo = std::numeric_limits<T>::min(), T hi = std::numeric_limits<T>::max())
+		: m_lo(lo), m_hi(hi)
+		{
+			if (!(lo <= hi))
+				throw std::invalid_argument("int_gen: lo <= hi is required.");
+		}
+
+		T operator() (xoshiro256ss& rng) const
+		{
+			if ((rng() & 7) == 0)
+			{
+				switch (rng.below(4))
+				{
+				case 0: return m_lo;
+				case 1: return m_hi;
+				case 2: return target();
+				default: return clamp(T(target() + 1));
+				}
+			}
+
+			uint64_t span = (uint64_t)m_hi - (uint64_t)m_lo + 1;
+			uint64_t r = span != 0 ? rng.below(span) : rng();
+			return (T)((uint64_t)m_lo + r);
+		}
+
+		// towards zero (or the bound closest to it): the target itself,
+		// then v moved towards it by 1/2, 1/4, ... of the distance, and by 1
+		void shrink(T v, std::vector<T>& out) const
+		{
+			T t = target();
+			if (v == t) return;
+
+			out.push_back(t);
+
+			// the distance in unsigned arithmetic (it may not fit in T)
+			bool up = v > t;
+			uint64_t d = up ? (uint64_t)v - (uint64_t)t : (uint64_t)t - (uint64_t)v;
+
+			for (uint64_t s = d / 2; s > 0; s /= 2)
+			{
+				out.push_back(up ? (T)((uint64_t)v - s) : (T)((uint64_t)v + s));
+			}
+		}
+
+	private:
+		T target() const
+		{
+			return m_lo > T(0) ? m_lo : (m_hi < T(0) ? m_hi : T(0));
+		}
+
+		T clamp(T v) const
+		{
+			return v < m_lo ? m_lo : (v > m_hi ? m_hi : v);
+		}
+
+	private:
+		T m_lo;
+		T m_hi;
+	};
+
+
+	/**
+	 * Values in [lo, hi], half of them uniform over the interval and
+	 * half uniform over the representable values (i.e. spread over the
+	 * binades). If with_specials is set, infinities and NaN are also
+	 * drawn as edge values.
+	 */
+	template<typename T>
+	class float_gen
+	{
+	public:
+		typedef T value_type;
+
+		float_gen(T lo = T(-1), T hi = T(1), bool with_specials = false)
+		: m_lo(lo), m_hi(hi), m_specials(with_specials)
+		{
+			if (!(lo <= hi) || std::isinf(lo) || std::isinf(hi))
+				throw std::invalid_argument("float_gen: finite lo <= hi is required.");
+		}
+
+		T operator() (xoshiro256ss& rng) const
+		{
+			if ((rng() & 7) == 0)
+			{
+				switch (rng.below(m_specials ? 8 : 5))
+				{
+				case 0: return m_lo;
+				case 1: return m_hi;
+				case 2: return clamp(T(0));
+				case 3: return clamp(std::numeric_limits<T>::denorm_min());
+				case 4: return clamp(T(1));
+				case 5: return std::numeric_limits<T>::infinity();
+				case 6: return -std::numeric_limits<T>::infinity();
+				default: return std::numeric_limits<T>::quiet_NaN();
+				}
+			}
+
+			if (rng.next_bool())
+			{
+				// interpolated, as hi - lo may overflow for a wide range
+				T u = static_cast<T>(rng.next_double());
+				return clamp(m_lo * (T(1) - u) + m_hi * u);
+			}
+			else
+			{
+				// the offsets in unsigned arithmetic (the difference of
+				// the ordered values may not fit in a signed integer)
+				typedef typename internal::ulp_repr<T>::sint_t sint_t;
+				uint64_t a = (uint64_t)(int64_t)internal::to_ordered(m_lo);
+				uint64_t b = (uint64_t)(int64_t)internal::to_ordered(m_hi);
+				uint64_t d = b - a;
+				uint64_t r = d != std::numeric_limits<uint64_t>::max() ? rng.below(d + 1) : rng();
+				return internal::from_ordered<T>((sint_t)(int64_t)(a + r));
+			}
+		}
+
+		// towards zero (or the bound closest to it), then integers
+		void shrink(T v, std::vector<T>& out) const
+		{
+			T t = clamp(T(0));
+			if (v == t) return;
+
+			out.push_back(t);
+			if (!(std::fabs(v) <= std::numeric_limits<T>::max())) return;  // inf or NaN
+
+			T r = std::trunc(v);
+			if (r != v && r != t && in_range(r)) out.push_back(r);
+
+			T h = v / 2;
+			if (h != v && h != t && in_range(h)) out.push_back(h);
+		}
+
+	private:
+		bool in_range(T v) const
+		{
+			return m_lo <= v && v <= m_hi;
+		}
+
+		T clamp(T v) const
+		{
+			return v < m_lo ? m_lo : (v > m_hi ? m_hi : v);
+		}
+
+	private:
+		T m_lo;
+		T m_hi;
+		bool m_specials;
+	};
+
+
+	template<class G>
+	class vector_gen
+	{
+	public:
+		typedef typename G::value_type elem_type;
+		typedef std::vector<elem_type> value_type;
+
+		vector_gen(const G& elem, size_t min_size, size_t max_size)
+		: m_elem(elem), m_min(min_size), m_max(max_size)
+		{
+			if (!(min_size <= max_size))
+				throw std::invalid_argument("vector_gen: min_size <= max_size is required.");
+		}
+
+		value_type operator() (xoshiro256ss& rng) const
+		{
+			size_t n = (rng() & 7) == 0 ? m_min : m_min + (size_t)rng.below(m_max - m_min + 1);
+
+			value_type v;
+			v.reserve(n);
+			for (size_t i = 0; i < n; ++i) v.push_back(m_elem(rng));
+			return v;
+		}
+
+		void shrink(const value_type& v, std::vector<value_type>& out) const
+		{
+			size_t n = v.size();
+
+			// drop the back or the front half
+			size_t h = n / 2;
+			if (h > 0 && n - h >= m_min)
+			{
+				out.push_back(value_type(v.begin(), v.begin() + (n - h)));
+				out.push_back(value_type(v.begin() + h, v.end()));
+			}
+
+			// drop one element
+			if (n > m_min)
+			{
+				for (size_t i = 0; i < n; ++i)
+				{
+					value_type u(v);
+					u.erase(u.begin() + i);
+					out.push_back(u);
+				}
+			}
+
+			// shrink one element
+			std::vector<elem_type> cands;
+			for (size_t i = 0; i < n; ++i)
+			{
+				cands.clear();
+				m_elem.shrink(v[i], cands);
+				if (!cands.empty())
+				{
+					value_type u(v);
+					u[i] = cands[0];
+					out.push_back(u);
+				}
+			}
+		}
+
+	private:
+		G m_elem;
+		size_t m_min;
+		size_t m_max;
+	};
+
+	template<class G>
+	inline vector_gen<G> vector_of(const G& elem, size_t min_size, size_t max_size)
+	{
+		return vector_gen<G>(elem, min_size, max_size);
+	}
+
+
+	// strings of printable ASCII characters
+	class string_gen
+	{
+	public:
+		typedef std::string value_type;
+
+		string_gen(size_t min_len, size_t max_len)
+		: m_min(min_len), m_max(max_len)
+		{
+			if (!(min_len <= max_len))
+				throw std::invalid_argument("string_gen: min_len <= max_len is required.");
+		}
+
+		std::string operator() (xoshiro256ss& rng) const
+		{
+			size_t n = (rng() & 7) == 0 ? m_min : m_min + (size_t)rng.below(m_max - m_min + 1);
+
+			std::string s(n, ' ');
+			for (size_t i = 0; i < n; ++i) s[i] = (char)(' ' + rng.below(95));
+			return s;
+		}
+
+		void shrink(const std::string& s, std::vector<std::string>& out) const
+		{
+			size_t n = s.size();
+
+			size_t h = n / 2;
+			if (h > 0 && n - h >= m_min)
+			{
+				out.push_back(s.substr(0, n - h));
+				out.push_back(s.substr(h));
+			}
+
+			if (n > m_min)
+			{
+				for (size_t i = 0; i < n; ++i)
+				{
+					out.push_back(std::string(s).erase(i, 1));
+				}
+			}
+
+			for (size_t i = 0; i < n; ++i)
+			{
+				if (s[i] != 'a')
+				{
+					std::string u(s);
+					u[i] = 'a';
+					out.push_back(u);
+				}
+			}
+		}
+
+	private:
+		size_t m_min;
+		size_t m_max;
+	};
+
+
+	/************************************************
+	 *
+	 *  Property test case
+	 *
+	 ************************************************/
+
+	namespace detail
+	{
+		template<size_t... I> struct index_seq { };
+
+		template<size_t N, size_t... I>
+		struct make_index_seq : make_index_seq<N - 1, N - 1, I...> { };
+
+		template<size_t... I>
+		struct make_index_seq<0, I...> { typedef index_seq<I...> type; };
+
+
+		// string representation of counterexamples
+
+		template<typename T>
+		inline std::string show(const T& v)
+		{
+			std::ostringstream oss;
+			oss.precision(std::numeric_limits<T>::max_digits10);
+			oss << v;
+			return oss.str();
+		}
+
+		inline std::string show(char c)
+		{
+			return show((int)c);
+		}
+
+		inline std::string show(signed char c)
+		{
+			return show((int)c);
+		}
+
+		inline std::string show(unsigned char c)
+		{
+			return show((int)c);
+		}
+
+		inline std::string show(const std::string& s)
+		{
+			return "\"" + s + "\"";
+		}
+
+		template<typename T>
+		inline std::string show(const std::vector<T>& v)
+		{
+			std::string s("[");
+			for (size_t i = 0; i < v.size(); ++i)
+			{
+				if (i > 0) s += ", ";
+				s += show(v[i]);
+			}
+			s += "]";
+			return s;
+		}
+
+		template<class Tuple, size_t I, size_t N>
+		struct show_args
+		{
+			static void run(const Tuple& t, std::string& s)
+			{
+				if (I > 0) s += ", ";
+				s += show(std::get<I>(t));
+				show_args<Tuple, I + 1, N>::run(t, s);
+			}
+		};
+
+		template<class Tuple, size_t N>
+		struct show_args<Tuple, N, N>
+		{
+			static void run(const Tuple& , std::string& ) { }
+		};
+
+
+		// a void property succeeds unless it throws
+		template<class F, class... Args>
+		inline bool eval_property(std::true_type, const F& f, const Args&... args)
+		{
+			f(args...);
+			return true;
+		}
+
+		template<class F, class... Args>
+		inline bool eval_property(std::false_type, const F& f, const Args&... args)
+		{
+			return static_cast<bool>(f(args...));
+		}
+
+		inline uint64_t name_hash(const char *s)
+		{
+			uint64_t h = 0xcbf29ce484222325ULL;   // FNV-1a
+			for (; *s; ++s) h = (h ^ (unsigned char)(*s)) * 0x100000001b3ULL;
+			return h;
+		}
+
+		inline uint64_t property_seed(const char *name)
+		{
+			const char *e = std::getenv("LTEST_SEED");
+			return e && *e ? (uint64_t)std::strtoull(e, 0, 10) : name_hash(name);
+		}
+
+
+		// restores the expectation log of the calling thread on exit,
+		// which drops the records added by the trials run on it
+		// (add() only writes at the current count)
+		class expectation_log_guard
+		{
+		public:
+			expectation_log_guard()
+			: m_log(current_expectations()), m_count(m_log.count)
+			{
+			}
+
+			~expectation_log_guard()
+			{
+				m_log.count = m_count;
+			}
+
+		private:
+			expectation_log_guard(const expectation_log_guard& );
+			expectation_log_guard& operator = (const expectation_log_guard& );
+
+			expectation_log& m_log;
+			size_t m_count;
+		};
+	}
+
+
+	template<class F, class... Gens>
+	class property_case : public test_case
+	{
+	public:
+		typedef std::tuple<typename Gens::value_type...> args_t;
+
+		/**
+		 * name, file and line are expected to be static strings
+		 * (as given by ADD_PROPERTY)
+		 */
+		property_case(const char *name, const char *file, unsigned int line,
+				F func, size_t ntrials, const Gens&... gens)
+		: m_name(name), m_file(file), m_line(line)
+		, m_func(func), m_ntrials(ntrials), m_gens(gens...)
+		, m_seed(detail::property_seed(name)), m_nthreads(0)
+		{
+		}
+
+		virtual const char *name() const
+		{
+			return m_name;
+		}
+
+		uint64_t seed() const
+		{
+			return m_seed;
+		}
+
+		void set_seed(uint64_t s)
+		{
+			m_seed = s;
+		}
+
+		// 0: use all hardware threads
+		void set_num_threads(unsigned int n)
+		{
+			m_nthreads = n;
+		}
+
+		virtual void run()
+		{
+			const size_t csiz = LTEST_PROPERTY_CHUNK_SIZE;
+			const size_t nchunks = (m_ntrials + csiz - 1) / csiz;
+			const size_t no_failure = std::numeric_limits<size_t>::max();
+
+			unsigned int nthreads = m_nthreads ? m_nthreads : std::thread::hardware_concurrency();
+			if (nthreads == 0) nthreads = 1;
+			if (nthreads > nchunks) nthreads = (unsigned int)(nchunks > 0 ? nchunks : 1);
+
+			std::atomic<size_t> next_chunk(0);
+			std::atomic<size_t> first_failure(no_failure);
+			std::mutex mtx;
+			args_t fail_args;
+			std::string fail_msg;
+
+			auto worker = [&]()
+			{
+				size_t c;
+				while ((c = next_chunk++) < nchunks)
+				{
+					// chunks are claimed in order, those before the
+					// earliest failure are never skipped
+					if (c * csiz >= first_failure.load()) break;
+
+					xoshiro256ss rng(splitmix64(m_seed ^ splitmix64(c)));
+					size_t end = c * csiz + csiz < m_ntrials ? c * csiz + csiz : m_ntrials;
+
+					for (size_t t = c * csiz; t < end; ++t)
+					{
+						args_t args = generate(rng, typename detail::make_index_seq<sizeof...(Gens)>::type());
+
+						std::string msg;
+						if (!holds(args, &msg))
+						{
+							std::lock_guard<std::mutex> lock(mtx);
+							if (t < first_failure.load())
+							{
+								first_failure = t;
+								fail_args = args;
+								fail_msg = msg;
+							}
+							break;
+						}
+					}
+				}
+			};
+
+			// worker 0 and the shrinking run on the calling thread
+			detail::expectation_log_guard elog_guard;
+
+			std::vector<std::thread> threads;
+			for (unsigned int i = 1; i < nthreads; ++i) threads.push_back(std::thread(worker));
+			worker();
+			for (size_t i = 0; i < threads.size(); ++i) threads[i].join();
+
+			size_t t = first_failure.load();
+			if (t == no_failure) return;
+
+			// shrinking
+			args_t cur = fail_args;
+			size_t nshrinks = 0;
+			while (nshrinks < LTEST_PROPERTY_MAX_SHRINKS && shrink_step<0>(cur, fail_msg)) ++nshrinks;
+
+			std::string detail = sformat((unsigned long long)(t + 1), "      falsified after %llu trials");
+			detail += sformat((unsigned long long)m_seed, " (seed = %llu)");
+			detail += "\n      counterexample: (" + show(fail_args) + ")";
+			if (nshrinks > 0)
+			{
+				detail += sformat(nshrinks, "\n      shrunk (%lu steps):  (") + show(cur) + ")";
+			}
+			if (!fail_msg.empty())
+			{
+				detail += "\n      " + fail_msg;
+			}
+
+			throw assertion_failure(m_file, m_line, m_name, detail);
+		}
+
+	private:
+		template<size_t... I>
+		args_t generate(xoshiro256ss& rng, detail::index_seq<I...>) const
+		{
+			// the elements of a braced list are evaluated in order
+			args_t args{ std::get<I>(m_gens)(rng)... };
+			return args;
+		}
+
+		template<size_t... I>
+		bool call(const args_t& args, detail::index_seq<I...>) const
+		{
+			typedef decltype(m_func(std::get<I>(args)...)) result_t;
+			return detail::eval_property(typename std::is_void<result_t>::type(), m_func, std::get<I>(args)...);
+		}
+
+		bool holds(const args_t& args, std::string *msg) const
+		{
+			try
+			{
+				return call(args, typename detail::make_index_seq<sizeof...(Gens)>::type());
+			}
+			catch (assertion_failure& e)
+			{
+				*msg = e.what();
+			}
+			catch (std::exception& e)
+			{
+				*msg = std::string("STD Exception: ") + (e.what() != 0 ? e.what() : "Unknown cause");
+			}
+			catch (...)
+			{
+				*msg = "Unknown exception";
+			}
+			return false;
+		}
+
+		// replaces cur by the first failing shrink candidate of any
+		// argument, returns false if there is none
+		template<size_t I>
+		typename std::enable_if<(I < sizeof...(Gens)), bool>::type
+		shrink_step(args_t& cur, std::string& msg) const
+		{
+			typedef typename std::tuple_element<I, args_t>::type T;
+
+			std::vector<T> cands;
+			std::get<I>(m_gens).shrink(std::get<I>(cur), cands);
+
+			for (size_t k = 0; k < cands.size(); ++k)
+			{
+				args_t a(cur);
+				std::get<I>(a) = cands[k];
+
+				std::string m;
+				if (!holds(a, &m))
+				{
+					cur = a;
+					msg = m;
+					return true;
+				}
+			}
+			return shrink_step<I + 1>(cur, msg);
+		}
+
+		template<size_t I>
+		typename std::enable_if<(I == sizeof...(Gens)), bool>::type
+		shrink_step(args_t& , std::string& ) const
+		{
+			return false;
+		}
+
+		static std::string show(const args_t& args)
+		{
+			std::string s;
+			detail::show_args<args_t, 0, sizeof...(Gens)>::run(args, s);
+			return s;
+		}
+
+	private:
+		const char *m_name;
+		const char *m_file;
+		unsigned int m_line;
+
+		F m_func;
+		size_t m_ntrials;
+		std::tuple<Gens...> m_gens;
+
+		uint64_t m_seed;
+		unsigned int m_nthreads;
+	};
+
+
+	template<class F, class... Gens>
+	inline property_case<F, Gens...>* make_property(const char *name, const char *file, unsigned int line,
+			F func, size_t ntrials, const Gens&... gens)
+	{
+		return new property_case<F, Gens...>(name, file, line, func, ntrials, gens...);
+	}
+
+}
+
+// to be used within AUTO_TPACK, e.g.
+//
+//   ADD_PROPERTY( prop_reverse_twice, 1000, ltest::vector_of(ltest::int_gen<int>(), 0, 50) )
+//
+// the case is registered by a factory, and constructed (with its generators)
+// only when it runs
+#define ADD_PROPERTY( Func, NTrials, ... ) \
+	this->add(#Func, []() -> ::ltest::test_case* { \
+		return ::ltest::make_property(#Func, __FILE__, __LINE__, &Func, NTrials, __VA_ARGS__); });
+
+#endif /* PROPERTY_H_ */
@@ -0,0 +1,207 @@
+/**
+ * @file roofline.h
+ *
+ * @brief Bandwidth and roofline figures of benchmark jobs
+ *
+ * Besides name() and size(), a job may declare the memory traffic
+ * and the arithmetic of each of its size() elements:
+ *
+ *   double bytes_read() const;
+ *   double bytes_written() const;
+ *   double flops() const;
+ *
+ * from which the bandwidth, throughput and arithmetic intensity of a
+ * run are derived. These are compared with the peaks of the host,
+ * measured once per process (on a single thread):
+ *
+ * - bandwidth: the STREAM triad a[i] = b[i] + s * c[i] over arrays of
+ *   LTEST_STREAM_SIZE doubles (counting 24 bytes per element)
+ * - flops: a multiply-add loop that the compiler can vectorize, so it
+ *   reflects the instruction set of the current build
+ *
+ * The roofline bound at intensity I is min(peak_gflops, I * peak_gbps).
+ * As the bandwidth peak is that of the main memory, a job whose data
+ * stays in cache can exceed 100% of it.
+ *
+ * @author Dahua Lin
+ */
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#ifndef LIGHT_TEST_ROOFLINE_H_
+#define LIGHT_TEST_ROOFLINE_H_
+
+#include "timer.h"
+#include <vector>
+
+// the length of each array of the STREAM triad (it should
+// be well beyond the size of the last level cache)
+#ifndef LTEST_STREAM_SIZE
+#define LTEST_STREAM_SIZE 10000000
+#endif
+
+namespace ltest
+{
+
+	namespace detail
+	{
+		// the optional declarations of jobs (0 if not declared)
+
+		template<class Job>
+		inline auto job_bytes_read(const Job& job, int) -> decltype(double(job.bytes_read()))
+		{
+			return double(job.bytes_read());
+		}
+
+		template<class Job>
+		inline double job_bytes_read(const Job& job, long)
+		{
+			return 0.0;
+		}
+
+		template<class Job>
+		inline auto job_bytes_written(const Job& job, int) -> decltype(double(job.bytes_written()))
+		{
+			return double(job.bytes_written());
+		}
+
+		template<class Job>
+		inline double job_bytes_written(const Job& job, long)
+		{
+			return 0.0;
+		}
+
+		template<class Job>
+		inline auto job_flops(const Job& job, int) -> decltype(double(job.flops()))
+		{
+			return double(job.flops());
+		}
+
+		template<class Job>
+		inline double job_flops(const Job& job, long)
+		{
+			return 0.0;
+		}
+	}
+
+
+	struct host_peak
+	{
+		double gbps;	// memory bandwidth (GB/s)
+		double gflops;	// floating-point throughput (GFLOP/s)
+
+		// the attainable GFLOP/s at the given intensity (flops per byte)
+		double roofline_gflops(double intensity) const
+		{
+			double b = intensity * gbps;
+			return b < gflops ? b : gflops;
+		}
+	};
+
+
+	namespace detail
+	{
+		inline double measure_stream_triad()
+		{
+			const size_t n = LTEST_STREAM_SIZE;
+			std::vector<double> a(n, 0.0), b(n, 1.0), c(n, 2.0);
+			double *pa = &a[0];
+			const double *pb = &b[0];
+			const double *pc = &c[0];
+			const double s = 3.0;
+
+			double best = 1.0e300;
+			for (int r = 0; r < 5; ++r)
+			{
+				timer tm(true);
+				for (size_t i = 0; i < n; ++i) pa[i] = pb[i] + s * pc[i];
+				double t = tm.elapsed_nsecs();
+				if (t < best) best = t;
+			}
+
+			// a sink, so that the loops are not optimized away
+			volatile double sink = pa[n / 2];
+			(void)sink;
+
+			return 24.0 * double(n) / best;
+		}
+
+		inline double measure_flops()
+		{
+			// independent accumulators, enough to fill the pipelines
+			const size_t m = 64;
+			const size_t nrep = 200000;
+			double x[m];
+			for (size_t j = 0; j < m; ++j) x[j] = double(j) * 1.0e-3;
+
+			const double u = 0.999999;
+			const double v = 1.0e-7;
+
+			double best = 1.0e300;
+			for (int r = 0; r < 5; ++r)
+			{
+				timer tm(true);
+				for (size_t k = 0; k < nrep; ++k)
+				{
+					for (size_t j = 0; j < m; ++j) x[j] = x[j] * u + v;
+				}
+				double t = tm.elapsed_nsecs();
+				if (t < best) best = t;
+			}
+
+			double s = 0.0;
+			for (size_t j = 0; j < m; ++j) s += x[j];
+			volatile double sink = s;
+			(void)sink;
+
+			return 2.0 * double(m) * double(nrep) / best;
+		}
+	}
+
+	/**
+	 * The peaks of the host, measured on first call (which takes
+	 * a fraction of a second)
+	 */
+	inline const host_peak& get_host_peak()
+	{
+		static const host_peak p = { detail::measure_stream_triad(), detail::measure_flops() };
+		return p;
+	}
+
+
+	/**
+	 * The per-element declarations of a job
+	 */
+	struct job_traffic
+	{
+		double bytes_read;
+		double bytes_written;
+		double flops;
+
+		template<class Job>
+		static job_traffic of(const Job& job)
+		{
+			job_traffic r = {
+				detail::job_bytes_read(job, 0),
+				detail::job_bytes_written(job, 0),
+				detail::job_flops(job, 0) };
+			return r;
+		}
+
+		double bytes() const
+		{
+			return bytes_read + bytes_written;
+		}
+
+		// flops per byte (0 if no traffic is declared)
+		double intensity() const
+		{
+			return bytes() > 0 ? flops / bytes() : 0.0;
+		}
+	};
+
+}
+
+#endif /* ROOFLINE_H_ */
@@ -0,0 +1,412 @@
+/**
+ * @file sampling_profiler.h
+ *
+ * @brief A sampling profiler for benchmark and test runs
+ *
+ * While running, the profiler is interrupted by SIGPROF at a fixed rate
+ * of CPU time (of the whole process), and records the call stack of the
+ * interrupted code into a buffer allocated on construction. The handler
+ * does not allocate or lock: it claims a slot of the buffer by an atomic
+ * increment (samples beyond the capacity are counted as dropped).
+ *
+ * The addresses are symbolized when reported, by dladdr, which only sees
+ * the exported symbols of each module. Build with -rdynamic to see the
+ * functions of the executable; code without a symbol is attributed to
+ * its module (shown as [module]). The rate of sampling is limited by the
+ * resolution of the CPU-time timers of the system (e.g. the scheduler
+ * tick on Linux).
+ *
+ * The profiler is available with glibc (Linux) and on OS X, where
+ * LTEST_HAS_SAMPLING_PROFILER is defined. Elsewhere it records nothing.
+ * Only one profiler can run at a time.
+ *
+ * @author Dahua Lin
+ */
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#ifndef LIGHT_TEST_SAMPLING_PROFILER_H_
+#define LIGHT_TEST_SAMPLING_PROFILER_H_
+
+#include "base.h"
+#include "str_template.h"
+
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#if (defined(__linux__) && defined(__GLIBC__)) || defined(__APPLE__)
+#define LTEST_HAS_SAMPLING_PROFILER
+#endif
+
+#ifdef LTEST_HAS_SAMPLING_PROFILER
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <signal.h>
+#include <sys/time.h>
+#include <ucontext.h>
+#include <cstdlib>
+#include <cstring>
+#endif
+
+// the maximum number of frames recorded per sample
+#ifndef LTEST_PROFILER_MAX_DEPTH
+#define LTEST_PROFILER_MAX_DEPTH 64
+#endif
+
+namespace ltest
+{
+
+	namespace detail
+	{
+#ifdef LTEST_HAS_SAMPLING_PROFILER
+		// the instruction pointer of the interrupted code (0 if unknown)
+		inline void *context_pc(void *ctx)
+		{
+			const ucontext_t *uc = static_cast<const ucontext_t*>(ctx);
+#if defined(__linux__) && defined(__x86_64__) && defined(REG_RIP)
+			return reinterpret_cast<void*>(uc->uc_mcontext.gregs[REG_RIP]);
+#elif defined(__linux__) && defined(__i386__) && defined(REG_EIP)
+			return reinterpret_cast<void*>(uc->uc_mcontext.gregs[REG_EIP]);
+#elif defined(__linux__) && defined(__aarch64__)
+			return reinterpret_cast<void*>(uc->uc_mcontext.pc);
+#elif defined(__APPLE__) && defined(__x86_64__)
+			return reinterpret_cast<void*>(uc->uc_mcontext->__ss.__rip);
+#elif defined(__APPLE__) && defined(__aarch64__)
+			return reinterpret_cast<void*>(uc->uc_mcontext->__ss.__pc);
+#else
+			(void)uc;
+			return 0;
+#endif
+		}
+
+		inline std::string demangle(const char *name)
+		{
+			int status = 0;
+			char *s = abi::__cxa_demangle(name, 0, 0, &status);
+			if (!s) return name;
+			std::string r(s);
+			std::free(s);
+			return r;
+		}
+#endif
+
+		// the name of the function at a code address
+		inline std::string symbolize(void *addr)
+		{
+#ifdef LTEST_HAS_SAMPLING_PROFILER
+			Dl_info info;
+			if (::dladdr(addr, &info))
+			{
+				if (info.dli_sname) return demangle(info.dli_sname);
+
+				if (info.dli_fname)
+				{
+					const char *base = std::strrchr(info.dli_fname, '/');
+					return std::string("[") + (base ? base + 1 : info.dli_fname) + "]";
+				}
+			}
+#endif
+			return sformat((size_t)addr, "0x%lx");
+		}
+	}
+
+
+	class sampling_profiler
+	{
+	public:
+		static const size_t max_depth = LTEST_PROFILER_MAX_DEPTH;
+
+		/**
+		 * hz is the number of samples per second of CPU time, and
+		 * max_samples the capacity of the buffer
+		 */
+		explicit sampling_profiler(unsigned int hz = 1000, size_t max_samples = 100000)
+		: m_hz(hz), m_capacity(max_samples)
+		, m_frames(max_samples * max_depth), m_depths(max_samples)
+		, m_next(0), m_dropped(0), m_running(false)
+		{
+		}
+
+		~sampling_profiler()
+		{
+			stop();
+		}
+
+		static bool is_supported()
+		{
+#ifdef LTEST_HAS_SAMPLING_PROFILER
+			return true;
+#else
+			return false;
+#endif
+		}
+
+		bool is_running() const
+		{
+			return m_running;
+		}
+
+		// the recorded samples (excluding the dropped ones)
+		size_t num_samples() const
+		{
+			size_t n = m_next.load();
+			return n < m_capacity ? n : m_capacity;
+		}
+
+		size_t num_dropped() const
+		{
+			return m_dropped.load();
+		}
+
+		/**
+		 * Starts sampling, adding to the samples recorded so far.
+		 * It throws std::logic_error if another profiler is running.
+		 */
+		void start()
+		{
+			if (m_running) return;
+#ifdef LTEST_HAS_SAMPLING_PROFILER
+			sampling_profiler *expected = 0;
+			if (!active().compare_exchange_strong(expected, this))
+				throw std::logic_error("Another sampling profiler is running.");
+
+			// the first call of backtrace may load the unwinder, which
+			// is not safe within a signal handler
+			void *warm[2];
+			::backtrace(warm, 2);
+
+			struct sigaction sa;
+			std::memset(&sa, 0, sizeof(sa));
+			sa.sa_sigaction = &on_signal;
+			sa.sa_flags = SA_SIGINFO | SA_RESTART;
+			sigemptyset(&sa.sa_mask);
+			::sigaction(SIGPROF, &sa, &m_old_action);
+
+			long usecs = m_hz > 0 ? 1000000L / (long)m_hz : 1000L;
+			if (usecs < 1) usecs = 1;
+			struct itimerval it;
+			it.it_interval.tv_sec = usecs / 1000000L;
+			it.it_interval.tv_usec = (int)(usecs % 1000000L);
+			it.it_value = it.it_interval;
+			::setitimer(ITIMER_PROF, &it, 0);
+#endif
+			m_running = true;
+		}
+
+		void stop()
+		{
+			if (!m_running) return;
+#ifdef LTEST_HAS_SAMPLING_PROFILER
+			// a SIGPROF may still be pending after the timer is disarmed,
+			// which must not reach the old action (by default, termination)
+			sigset_t prof, old_mask;
+			sigemptyset(&prof);
+			sigaddset(&prof, SIGPROF);
+			::pthread_sigmask(SIG_BLOCK, &prof, &old_mask);
+
+			struct itimerval it;
+			std::memset(&it, 0, sizeof(it));
+			::setitimer(ITIMER_PROF, &it, 0);
+
+			sigset_t pending;
+			sigemptyset(&pending);
+			if (::sigpending(&pending) == 0 && sigismember(&pending, SIGPROF))
+			{
+				int sig;
+				::sigwait(&prof, &sig);
+			}
+
+			::sigaction(SIGPROF, &m_old_action, 0);
+			active().store(0);
+			::pthread_sigmask(SIG_SETMASK, &old_mask, 0);
+#endif
+			m_running = false;
+		}
+
+		// discards the samples (the profiler should not be running)
+		void clear()
+		{
+			m_next = 0;
+			m_dropped = 0;
+		}
+
+	public:
+		/**
+		 * Prints the n functions with the most samples, by the samples
+		 * in the function itself (self) and within its calls (total).
+		 */
+		void print_top(std::ostream& out, size_t n = 20) const
+		{
+			const size_t ns = num_samples();
+			std::map<void*, std::string> names;
+			std::map<std::string, size_t> self;
+			std::map<std::string, size_t> total;
+
+			std::vector<const std::string*> seen;
+			for (size_t i = 0; i < ns; ++i)
+			{
+				const size_t d = m_depths[i];
+				if (d == 0) continue;
+
+				++ self[frame_name(names, i, 0)];
+
+				// a recursive function counts once per sample
+				seen.clear();
+				for (size_t k = 0; k < d; ++k)
+				{
+					const std::string& s = frame_name(names, i, k);
+					size_t j = 0;
+					while (j < seen.size() && *seen[j] != s) ++j;
+					if (j == seen.size())
+					{
+						seen.push_back(&s);
+						++ total[s];
+					}
+				}
+			}
+
+			std::vector<std::pair<size_t, std::string> > rows;
+			for (std::map<std::string, size_t>::const_iterator it = self.begin(); it != self.end(); ++it)
+			{
+				rows.push_back(std::make_pair(it->second, it->first));
+			}
+			std::sort(rows.begin(), rows.end(), row_before);
+			if (rows.size() > n) rows.resize(n);
+
+			out << sformat(ns, "%lu samples");
+			if (num_dropped() > 0) out << sformat(num_dropped(), " (%lu dropped)");
+			out << "\n";
+			out << "   self%   total%  function\n";
+
+			const double r = ns > 0 ? 100.0 / double(ns) : 0.0;
+			for (size_t i = 0; i < rows.size(); ++i)
+			{
+				out << sformat(double(rows[i].first) * r, "  %6.2f")
+					<< sformat(double(total[rows[i].second]) * r, "   %6.2f")
+					<< "  " << rows[i].second << "\n";
+			}
+		}
+
+		/**
+		 * Writes the stacks in the folded format, i.e. one line per
+		 * distinct stack, as "outer;...;inner count", which is taken by
+		 * flamegraph.pl and speedscope.
+		 */
+		void write_folded(std::ostream& out) const
+		{
+			const size_t ns = num_samples();
+			std::map<void*, std::string> names;
+			std::map<std::string, size_t> stacks;
+
+			std::string s;
+			for (size_t i = 0; i < ns; ++i)
+			{
+				const size_t d = m_depths[i];
+				if (d == 0) continue;
+
+				s.clear();
+				for (size_t k = d; k > 0; --k)
+				{
+					s += frame_name(names, i, k - 1);
+					if (k > 1) s += ';';
+				}
+				++ stacks[s];
+			}
+
+			for (std::map<std::string, size_t>::const_iterator it = stacks.begin(); it != stacks.end(); ++it)
+			{
+				out << it->first << sformat(it->second, " %lu\n");
+			}
+		}
+
+	private:
+		// frame k of sample i (k = 0 being the innermost)
+		const std::string& frame_name(std::map<void*, std::string>& names, size_t i, size_t k) const
+		{
+			void *a = m_frames[i * max_depth + k];
+
+			// the outer frames hold return addresses, which may be
+			// past the end of the calling function
+			if (k > 0) a = static_cast<char*>(a) - 1;
+
+			std::map<void*, std::string>::iterator it = names.find(a);
+			if (it == names.end()) it = names.insert(std::make_pair(a, detail::symbolize(a))).first;
+			return it->second;
+		}
+
+		static bool row_before(const std::pair<size_t, std::string>& a, const std::pair<size_t, std::string>& b)
+		{
+			return a.first > b.first || (a.first == b.first && a.second < b.second);
+		}
+
+#ifdef LTEST_HAS_SAMPLING_PROFILER
+		static std::atomic<sampling_profiler*>& active()
+		{
+			static std::atomic<sampling_profiler*> p(0);
+			return p;
+		}
+
+		static void on_signal(int sig, siginfo_t *info, void *ctx)
+		{
+			sampling_profiler *p = active().load();
+			if (p) p->record(ctx);
+		}
+
+		void record(void *ctx)
+		{
+			const size_t i = m_next.fetch_add(1);
+			if (i >= m_capacity)
+			{
+				++ m_dropped;
+				return;
+			}
+
+			// the first frames are those of the handler and of the
+			// signal trampoline, which end at the interrupted code
+			void *raw[max_depth + 4];
+			int n = ::backtrace(raw, (int)(max_depth + 4));
+			void *pc = detail::context_pc(ctx);
+
+			int s = 0;
+			while (s < n && s < 4 && raw[s] != pc) ++s;
+
+			void **f = &m_frames[i * max_depth];
+			size_t d = 0;
+			if (s == n || s == 4)
+			{
+				// the interrupted frame is not found by the unwinder
+				s = 2;
+				if (pc) f[d++] = pc;
+			}
+			for (int k = s; k < n && d < max_depth; ++k) f[d++] = raw[k];
+			m_depths[i] = d;
+		}
+#endif
+
+		sampling_profiler(const sampling_profiler& );
+		sampling_profiler& operator = (const sampling_profiler& );
+
+	private:
+		unsigned int m_hz;
+		size_t m_capacity;
+		std::vector<void*> m_frames;
+		std::vector<size_t> m_depths;
+		std::atomic<size_t> m_next;
+		std::atomic<size_t> m_dropped;
+		bool m_running;
+#ifdef LTEST_HAS_SAMPLING_PROFILER
+		struct sigaction m_old_action;
+#endif
+	};
+
+}
+
+#endif /* SAMPLING_PROFILER_H_ */
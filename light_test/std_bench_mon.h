@@ -15,9 +15,19 @@
 
 #include "str_template.h"
 #include "timer.h"
+#include "latency_histogram.h"
+#include "benchmark.h"
+#include "roofline.h"
+#include "load_benchmark.h"
 
 #define LTEST_STD_REPORT_TEMPLATE "{{jobname : %-28s}}:  {{times: %10lu}}  | {{secs: %10.4f}} s  | {{mps: %10.2f}} MPS\n"
 
+#define LTEST_COMPARE_REPORT_TEMPLATE "{{jobname : %-28s}}:  {{mps: %10.2f}} MPS  | {{speedup: %7.3f}}x  [{{speedup_lo: %7.3f}}, {{speedup_hi: %7.3f}}]  vs {{baseline}}\n"
+
+#define LTEST_LOAD_REPORT_TEMPLATE "{{jobname : %-28s}}:  {{offered: %10.0f}} /s offered  {{achieved: %10.0f}} /s achieved  | p50 {{p50: %9.1f}}  p99 {{p99: %9.1f}}  max {{lat_max: %9.1f}} ns\n"
+
+#define LTEST_LATENCY_REPORT_TEMPLATE "{{jobname : %-28s}}:  {{times: %10lu}}  | p50 {{p50: %9.1f}}  p99 {{p99: %9.1f}}  p999 {{p999: %9.1f}}  max {{lat_max: %9.1f}} ns\n"
+
 namespace ltest
 {
 
@@ -26,11 +36,38 @@ namespace ltest
 	public:
 		template<class Job>
 		bench_report_source(const Job& job, size_t n, const runtime_span& span)
-		: m_jobname(job.name())
-		, m_jobsize(job.size())
-		, m_times(n)
-		, m_runsize(m_jobsize * m_times)
-		, m_span(span)
+		: bench_report_source(job, n, span, 0, 0, 0, 0)
+		{ }
+
+		// warmup (calls), warmup_secs, batches and rel_ci
+		template<class Job>
+		bench_report_source(const Job& job, size_t n, const runtime_span& span,
+				const bench_stats& stats)
+		: bench_report_source(job, n, span, 0, &stats, 0, 0)
+		{ }
+
+		// the latencies (p50, p90, p99, p999, lat_min, lat_max and
+		// lat_mean) are reported in nanoseconds
+		template<class Job>
+		bench_report_source(const Job& job, size_t n, const runtime_span& span,
+				const latency_histogram& latency)
+		: bench_report_source(job, n, span, &latency, 0, 0, 0)
+		{ }
+
+		// offered and achieved (calls per second), missed, the latencies
+		// from the intended starts (as above), and the service times
+		// svc_p50, svc_p99 and svc_p999 (in nanoseconds)
+		template<class Job>
+		bench_report_source(const Job& job, size_t n, const runtime_span& span,
+				const load_result& load)
+		: bench_report_source(job, n, span, &load.latency, 0, 0, &load)
+		{ }
+
+		// baseline, speedup, speedup_lo, speedup_hi and rounds
+		template<class Job>
+		bench_report_source(const Job& job, size_t n, const runtime_span& span,
+				const bench_relative& relative)
+		: bench_report_source(job, n, span, 0, 0, &relative, 0)
 		{ }
 
 		std::string operator() (const char *name, const char *fmt=0) const
@@ -46,10 +83,110 @@ namespace ltest
 			else if (str_eq(name, "mps")) return _fmt(m_span.mps(m_runsize), fmt);
 			else if (str_eq(name, "kps")) return _fmt(m_span.kps(m_runsize), fmt);
 			else if (str_eq(name, "ps"))  return _fmt(m_span.ps(m_runsize), fmt);
+			else if (str_eq(name, "gbps")) return _fmt(_gbps(), fmt);
+			else if (str_eq(name, "gflops")) return _fmt(_gflops(), fmt);
+			else if (str_eq(name, "intensity")) return _fmt(m_traffic.intensity(), fmt);
+			else if (str_eq(name, "peak_gbps")) return _fmt(get_host_peak().gbps, fmt);
+			else if (str_eq(name, "peak_gflops")) return _fmt(get_host_peak().gflops, fmt);
+			else if (str_eq(name, "roofline")) return _roofline(fmt);
+			else if (m_load) return _load(name, fmt);
+			else if (m_latency) return _latency(name, fmt);
+			else if (m_stats) return _stats(name, fmt);
+			else if (m_relative) return _relative(name, fmt);
 			else return "####";
 		}
 
 	private:
+		template<class Job>
+		bench_report_source(const Job& job, size_t n, const runtime_span& span,
+				const latency_histogram *latency, const bench_stats *stats,
+				const bench_relative *relative, const load_result *load)
+		: m_jobname(job.name())
+		, m_jobsize(job.size())
+		, m_times(n)
+		, m_runsize(m_jobsize * m_times)
+		, m_span(span)
+		, m_traffic(job_traffic::of(job))
+		, m_latency(latency)
+		, m_stats(stats)
+		, m_relative(relative)
+		, m_load(load)
+		{ }
+
+		double _gbps() const
+		{
+			return m_traffic.bytes() * double(m_runsize) / m_span.nsecs();
+		}
+
+		double _gflops() const
+		{
+			return m_traffic.flops * double(m_runsize) / m_span.nsecs();
+		}
+
+		// the achieved percentage of the roofline bound
+		std::string _roofline(const char *fmt) const
+		{
+			const host_peak& p = get_host_peak();
+			double b = m_traffic.bytes();
+			double f = m_traffic.flops;
+
+			if (f > 0 && b > 0) return _fmt(100.0 * _gflops() / p.roofline_gflops(m_traffic.intensity()), fmt);
+			else if (f > 0) return _fmt(100.0 * _gflops() / p.gflops, fmt);
+			else if (b > 0) return _fmt(100.0 * _gbps() / p.gbps, fmt);
+			else return "####";
+		}
+
+		std::string _latency(const char *name, const char *fmt) const
+		{
+			const latency_histogram& h = *m_latency;
+			double u = h.unit_nsecs();
+
+			if (str_eq(name, "p50")) return _fmt(h.nsecs_at(0.5), fmt);
+			else if (str_eq(name, "p90")) return _fmt(h.nsecs_at(0.9), fmt);
+			else if (str_eq(name, "p99")) return _fmt(h.nsecs_at(0.99), fmt);
+			else if (str_eq(name, "p999")) return _fmt(h.nsecs_at(0.999), fmt);
+			else if (str_eq(name, "lat_min")) return _fmt(double(h.min()) * u, fmt);
+			else if (str_eq(name, "lat_max")) return _fmt(double(h.max()) * u, fmt);
+			else if (str_eq(name, "lat_mean")) return _fmt(h.mean() * u, fmt);
+			else return "####";
+		}
+
+		std::string _load(const char *name, const char *fmt) const
+		{
+			const load_result& r = *m_load;
+
+			if (str_eq(name, "offered")) return _fmt(r.offered_rate, fmt);
+			else if (str_eq(name, "achieved")) return _fmt(r.achieved_rate, fmt);
+			else if (str_eq(name, "missed")) return _fmt(r.missed, fmt);
+			else if (str_eq(name, "svc_p50")) return _fmt(r.service.nsecs_at(0.5), fmt);
+			else if (str_eq(name, "svc_p99")) return _fmt(r.service.nsecs_at(0.99), fmt);
+			else if (str_eq(name, "svc_p999")) return _fmt(r.service.nsecs_at(0.999), fmt);
+			else return _latency(name, fmt);
+		}
+
+		std::string _stats(const char *name, const char *fmt) const
+		{
+			const bench_stats& s = *m_stats;
+
+			if (str_eq(name, "warmup")) return _fmt(s.warmup_runs, fmt);
+			else if (str_eq(name, "warmup_secs")) return _fmt(s.warmup_secs, fmt);
+			else if (str_eq(name, "batches")) return _fmt(s.num_batches, fmt);
+			else if (str_eq(name, "rel_ci")) return _fmt(s.rel_ci, fmt);
+			else return "####";
+		}
+
+		std::string _relative(const char *name, const char *fmt) const
+		{
+			const bench_relative& r = *m_relative;
+
+			if (str_eq(name, "baseline")) return _fmt(std::string(r.baseline), fmt);
+			else if (str_eq(name, "speedup")) return _fmt(r.speedup, fmt);
+			else if (str_eq(name, "speedup_lo")) return _fmt(r.speedup_lo, fmt);
+			else if (str_eq(name, "speedup_hi")) return _fmt(r.speedup_hi, fmt);
+			else if (str_eq(name, "rounds")) return _fmt(r.rounds, fmt);
+			else return "####";
+		}
+
 		static std::string _fmt(const std::string& v, const char *fmt)
 		{
 			return fmt ? sformat(v.c_str(), fmt) : v;
@@ -71,6 +208,11 @@ namespace ltest
 		size_t m_times;
 		size_t m_runsize;
 		runtime_span m_span;
+		job_traffic m_traffic;
+		const latency_histogram *m_latency;
+		const bench_stats *m_stats;
+		const bench_relative *m_relative;
+		const load_result *m_load;
 	};
 
 
@@ -100,6 +242,34 @@ namespace ltest
 			m_channel << src;
 		}
 
+		template<class Job>
+		void operator() (const Job& job, size_t n, const runtime_span& span, const bench_stats& stats)
+		{
+			bench_report_source src(job, n, span, stats);
+			m_channel << src;
+		}
+
+		template<class Job>
+		void operator() (const Job& job, size_t n, const runtime_span& span, const latency_histogram& latency)
+		{
+			bench_report_source src(job, n, span, latency);
+			m_channel << src;
+		}
+
+		template<class Job>
+		void operator() (const Job& job, size_t n, const runtime_span& span, const bench_relative& relative)
+		{
+			bench_report_source src(job, n, span, relative);
+			m_channel << src;
+		}
+
+		template<class Job>
+		void operator() (const Job& job, size_t n, const runtime_span& span, const load_result& load)
+		{
+			bench_report_source src(job, n, span, load);
+			m_channel << src;
+		}
+
 	private:
 		void _init()
 		{
@@ -29,6 +29,7 @@ namespace ltest
 		{
 			m_csuite = 0;
 			m_cpack = 0;
+			m_pack_ncases = 0;
 
 			m_isuite = 0;
 			m_ipack = 0;
@@ -36,6 +37,9 @@ namespace ltest
 
 			m_finished_cases = 0;
 			m_passed_cases = 0;
+
+			m_in_case = false;
+			m_case_marked = false;
 		}
 
 		size_t total_finished_cases() const
@@ -73,10 +77,16 @@ namespace ltest
 			m_icase = 0;
 		}
 
+		virtual void on_pack_selection(const test_pack& tpack, size_t ncases)
+		{
+			m_pack_ncases = ncases;
+		}
+
 		virtual void on_pack_begin(const test_pack& tpack)
 		{
 			++ m_ipack;
 			m_cpack = &tpack;
+			if (m_pack_ncases == 0) m_pack_ncases = tpack.size();
 			print_pack_begin(tpack);
 		}
 
@@ -85,17 +95,21 @@ namespace ltest
 			print_pack_end(tpack, npassed_cases);
 
 			m_icase = 0;
+			m_pack_ncases = 0;
 		}
 
 		virtual void on_case_begin(const test_case& tcase)
 		{
 			++ m_icase;
+			m_in_case = true;
+			m_case_marked = false;
 			print_case_begin(tcase);
 		}
 
 		virtual void on_case_end(const test_case& tcase, bool is_passed)
 		{
 			print_case_end(tcase, is_passed);
+			m_in_case = false;
 		}
 
 		virtual void on_assertion_failure(const assertion_failure& e)
@@ -108,6 +122,11 @@ namespace ltest
 			print_exception(e);
 		}
 
+		virtual void on_expectation_failures(const expectation_log& log)
+		{
+			print_expectation_failures(log);
+		}
+
 	private:
 		void print_suite_begin(const test_suite& tsuite)
 		{
@@ -143,10 +162,10 @@ namespace ltest
 			printf_with_color(color_sepline, "\n----------------------\n");
 		}
 
-		void print_pack_end(const test_pack& tpack, size_t npassed_cases)
+		void print_pack_end(const test_pack&, size_t npassed_cases)
 		{
 			printf_with_color(color_sepline, "----------------------\n");
-			printf_with_color_bold(color_stats, "%lu / %lu cases passed\n", npassed_cases, tpack.size());
+			printf_with_color_bold(color_stats, "%lu / %lu cases passed\n", npassed_cases, m_icase);
 			std::printf("\n");
 		}
 
@@ -157,7 +176,7 @@ namespace ltest
 				std::string title = tcase.name();
 
 				printf_with_color(color_unittype, "  [%3lu / %3lu]: ",
-						m_icase, m_cpack->size());
+						m_icase, m_pack_ncases);
 
 				printf_with_color(color_unitname, " %-40s", title.c_str());
 			}
@@ -180,7 +199,7 @@ namespace ltest
 
 		void print_assertion_failure(const assertion_failure& e)
 		{
-			printf_with_color(color_fail, "failed\n");
+			print_failed_mark();
 			printf_with_color_bold(color_location, "   **** %s (%u): ", e.file_name(), e.line_number());
 			std::printf("%s\n", e.what());
 			std::printf("\n");
@@ -190,11 +209,43 @@ namespace ltest
 		{
 			const char *msg = e.what() != 0 ? e.what() : "Unknown cause";
 
-			printf_with_color(color_fail, "failed\n");
+			print_failed_mark();
 			std::printf("   **** STD Exception: %s\n", msg);
 			std::printf("\n");
 		}
 
+		void print_expectation_failures(const expectation_log& log)
+		{
+			print_failed_mark();
+			for (size_t i = 0; i < log.num_records(); ++i)
+			{
+				const expectation_failure_info& r = log.records[i];
+				printf_with_color_bold(color_location, "   **** %s (%u): ", r.file, r.line);
+				if (r.values[0]) std::printf("Expectation failed: %s (%s)\n", r.expr, r.values);
+				else std::printf("Expectation failed: %s\n", r.expr);
+			}
+			if (log.count > log.num_records())
+			{
+				std::printf("   **** ... (%lu more expectation failures)\n", log.count - log.num_records());
+			}
+			std::printf("\n");
+		}
+
+		void print_failed_mark()
+		{
+			if (m_in_case)
+			{
+				// a case may report several failures (e.g. expectations
+				// followed by an assertion), it is marked only once
+				if (!m_case_marked) printf_with_color(color_fail, "failed\n");
+				m_case_marked = true;
+			}
+			else  // failed outside of a case (e.g. in a fixture)
+			{
+				printf_with_color(color_fail, "  fixture failed\n");
+			}
+		}
+
 	public:
 		static const color_t color_fail = LTCOLOR_RED;
 		static const color_t color_pass = LTCOLOR_GREEN;
@@ -211,22 +262,33 @@ namespace ltest
 		size_t m_isuite;
 		size_t m_ipack;
 		size_t m_icase;
+		size_t m_pack_ncases;	// the cases of the current pack that run
 
 		size_t m_finished_cases; // update upon the end of a suite
 		size_t m_passed_cases;   // update upon the end of a suite
 
+		bool m_in_case;
+		bool m_case_marked;
+
 	}; // end class std_test_monitor
 
 
 
-	inline bool std_test_main(test_suite& master_suite)
+	inline bool std_test_main(test_suite& master_suite, const char *filter = 0)
 	{
 		std_test_monitor mon;
-		execute_suite(master_suite, mon);
+		execute_suite(master_suite, mon, test_filter(filter));
 
 		bool all_passed = mon.is_all_passed();
 
-		if (all_passed)
+		if (mon.total_finished_cases() == 0 && filter && *filter)
+		{
+			// most likely a mistyped pattern
+			printf_with_color_bold(std_test_monitor::color_fail,
+					"No case matches the filter \"%s\"!\n", filter);
+			all_passed = false;
+		}
+		else if (all_passed)
 		{
 			printf_with_color_bold(std_test_monitor::color_pass,
 					"All %lu cases passed!\n", mon.total_finished_cases());
@@ -0,0 +1,186 @@
+/**
+ * @file tap_test_mon.h
+ *
+ * Testing monitor that writes TAP (Test Anything Protocol) output
+ *
+ * @author Dahua Lin
+ */
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#ifndef LIGHT_TEST_TAP_TEST_MON_H_
+#define LIGHT_TEST_TAP_TEST_MON_H_
+
+#include "test_assertions.h"
+#include "test_units.h"
+#include "test_mon.h"
+#include "str_template.h"
+#include "internal/case_record.h"
+
+#include <ostream>
+
+namespace ltest
+{
+
+	inline std::string yaml_quote(const std::string& s)
+	{
+		std::string r("'");
+		for (std::string::const_iterator it = s.begin(); it != s.end(); ++it)
+		{
+			if (*it == '\'') r += "''";
+			else if (*it == '\n') r += ' ';
+			else r += *it;
+		}
+		r += '\'';
+		return r;
+	}
+
+
+	/**
+	 * Writes a TAP version 13 stream, one test point per case.
+	 *
+	 * Each test point is written and flushed as soon as its case ends,
+	 * failures carry a YAML diagnostic block. The plan line is written
+	 * at the end of the suite.
+	 *
+	 * Case-level callbacks may come from different threads at the same
+	 * time; pack and suite callbacks are expected from a single thread.
+	 */
+	class tap_test_monitor : public test_monitor
+	{
+	public:
+		explicit tap_test_monitor(std::ostream& out)
+		: m_out(out), m_ncases(0)
+		{
+			m_out << "TAP version 13\n";
+		}
+
+	public:
+		virtual void on_suite_begin(const test_suite& tsuite)
+		{
+			m_out << "# Test Suite " << tsuite.name() << "\n";
+			m_out.flush();
+		}
+
+		virtual void on_suite_end(const test_suite& tsuite, size_t nfinished_cases, size_t npassed_cases)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			m_out << "1.." << m_ncases << "\n";
+			m_out << "# " << npassed_cases << " / " << nfinished_cases << " cases passed\n";
+			m_out.flush();
+		}
+
+		virtual void on_pack_begin(const test_pack& tpack)
+		{
+			m_pack_name = tpack.name();
+
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_out << "# Test Pack " << m_pack_name << "\n";
+			m_out.flush();
+		}
+
+		virtual void on_case_begin(const test_case& tcase)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_records.open(tcase);
+		}
+
+		virtual void on_case_end(const test_case& tcase, bool is_passed)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			internal::case_record *r = m_records.current();
+			if (!r) return;
+			if (!is_passed && r->status == internal::CASE_PASSED) r->set_unexplained_failure();
+
+			double ms = r->tm.elapsed_msecs();
+
+			if (r->status == internal::CASE_PASSED)
+			{
+				m_out << "ok " << ++m_ncases << " - " << m_pack_name << " / " << tcase.name()
+					  << " # time=" << sformat(ms, "%.3f") << "ms\n";
+			}
+			else
+			{
+				m_out << "not ok " << ++m_ncases << " - " << m_pack_name << " / " << tcase.name() << "\n"
+					  << "  ---\n"
+					  << "  message: " << yaml_quote(r->message) << "\n"
+					  << "  severity: " << (r->status == internal::CASE_ERROR ? "error" : "fail") << "\n";
+
+				if (r->status == internal::CASE_FAILED)
+				{
+					m_out << "  at:\n"
+						  << "    file: " << yaml_quote(r->file) << "\n"
+						  << "    line: " << r->line << "\n";
+				}
+
+				m_out << "  duration_ms: " << sformat(ms, "%.3f") << "\n"
+					  << "  ...\n";
+			}
+
+			m_out.flush();
+			m_records.close();
+		}
+
+		virtual void on_assertion_failure(const assertion_failure& e)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			internal::case_record *r = m_records.current();
+			if (r) r->set_failure(e);
+			else write_fixture_error(e.what());
+		}
+
+		virtual void on_exception(const std::exception& e)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			internal::case_record *r = m_records.current();
+			if (r) r->set_error(e);
+			else write_fixture_error(e.what() != 0 ? e.what() : "Unknown cause");
+		}
+
+		virtual void on_expectation_failures(const expectation_log& log)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			internal::case_record *r = m_records.current();
+			if (r) r->add_expectation_failures(log);
+			else write_fixture_error(log.str().c_str());
+		}
+
+	private:
+		// failures outside of cases (in pack or suite fixtures)
+
+		void write_fixture_error(const char *msg)
+		{
+			m_out << "# fixture error: ";
+			for (; *msg; ++msg)
+			{
+				m_out << *msg;
+				if (*msg == '\n') m_out << "#   ";  // each line is a diagnostic
+			}
+			m_out << "\n";
+			m_out.flush();
+		}
+
+	private:
+		tap_test_monitor(const tap_test_monitor& );
+		tap_test_monitor& operator = (const tap_test_monitor& );
+
+	private:
+		std::ostream& m_out;
+		std::mutex m_mutex;
+		internal::case_record_table m_records;
+
+		std::string m_pack_name;
+		size_t m_ncases;
+
+	}; // end class tap_test_monitor
+
+}
+
+#endif /* TAP_TEST_MON_H_ */
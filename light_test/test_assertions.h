@@ -15,11 +15,22 @@
 
 #include "base.h"
 #include "float_accuracy.h"
+#include "tolerance.h"
+#include "internal/vec_kernels.h"
+#include "mismatch_report.h"
 #include <cmath>
 #include <cstring>
+#include <limits>
 
 namespace ltest
 {
+	/**
+	 * The file name and the assertion text are kept as pointers, they are
+	 * expected to be static strings (__FILE__ and stringized expressions).
+	 * A message is only built when there is a mismatch detail to append,
+	 * so that throwing a plain assertion failure does not allocate, and
+	 * what() neither allocates nor modifies the object.
+	 */
 	class assertion_failure : public std::exception
 	{
 	public:
@@ -27,18 +38,34 @@ namespace ltest
 		: m_file(file)
 		, m_line(line)
 		, m_assertion(assertion)
-		, m_message(std::string("Assertion failed: ") + m_assertion)
 		{
 		}
 
+		assertion_failure(const char *file, unsigned int line, const char *assertion, const std::string& detail)
+		: m_file(file)
+		, m_line(line)
+		, m_assertion(assertion)
+		{
+			if (!detail.empty())
+			{
+				m_message.reserve(std::strlen(assertion) + 1 + detail.size());
+				m_message += assertion;
+				m_message += '\n';
+				m_message += detail;
+			}
+		}
+
 		virtual ~assertion_failure() throw() { }
 
-		virtual const char *what() const throw() { return m_message.c_str(); }
+		virtual const char *what() const throw()
+		{
+			return m_message.empty() ? m_assertion : m_message.c_str();
+		}
 
 	public:
 		const char *file_name() const
 		{
-			return m_file.c_str();
+			return m_file;
 		}
 
 		unsigned int line_number() const
@@ -48,13 +75,13 @@ namespace ltest
 
 		const char *assertion() const
 		{
-			return m_assertion.c_str();
+			return m_assertion;
 		}
 
 	private:
-		std::string m_file;
+		const char *m_file;
 		unsigned int m_line;
-		std::string m_assertion;
+		const char *m_assertion;
 		std::string m_message;
 
 	}; // end class assertion_failure
@@ -66,12 +93,145 @@ namespace ltest
 	 *
 	 ************************************************/
 
+	namespace detail
+	{
+		// arguments that refer to contiguous float (1) or double (2) arrays
+
+		template<class V> struct contiguous_kind { static const int value = 0; };
+
+		template<> struct contiguous_kind<float*> { static const int value = 1; };
+		template<> struct contiguous_kind<const float*> { static const int value = 1; };
+		template<size_t N> struct contiguous_kind<float[N]> { static const int value = 1; };
+		template<size_t N> struct contiguous_kind<const float[N]> { static const int value = 1; };
+
+		template<> struct contiguous_kind<double*> { static const int value = 2; };
+		template<> struct contiguous_kind<const double*> { static const int value = 2; };
+		template<size_t N> struct contiguous_kind<double[N]> { static const int value = 2; };
+		template<size_t N> struct contiguous_kind<const double[N]> { static const int value = 2; };
+
+		template<class VecA, class VecB>
+		struct simd_kind
+		{
+			static const int value = contiguous_kind<VecA>::value == contiguous_kind<VecB>::value ?
+					contiguous_kind<VecA>::value : 0;
+		};
+
+		// contiguous arrays are compared in blocks, within which the
+		// loop has no branches (so that it can be vectorized)
+
+		template<typename T, class Policy>
+		inline bool approx_contiguous(size_t n, const T *a, const T *b, const Policy& p)
+		{
+			const size_t bsiz = 256;
+			typename Policy::template kernel<T> k = p.template bind<T>();
+
+			for (size_t i = 0; i < n; i += bsiz)
+			{
+				size_t m = n - i < bsiz ? n - i : bsiz;
+				// counting (rather than and-ing bools) is what the
+				// vectorizer handles as a reduction
+				unsigned int nfail = 0;
+				for (size_t j = 0; j < m; ++j) nfail += !k(a[i + j], b[i + j]);
+				if (nfail) return false;
+			}
+			return true;
+		}
+
+		template<typename T>
+		inline bool approx_contiguous(size_t n, const T *a, const T *b, const abs_tolerance<false>& p)
+		{
+			return internal::vec_approx(n, a, b, tol_as<T>(p.atol()), true);
+		}
+
+		template<typename T>
+		inline bool approx_contiguous(size_t n, const T *a, const T *b, const plain_tolerance& p)
+		{
+			return internal::vec_approx(n, a, b, tol_as<T>(p.atol()), false);
+		}
+
+
+		template<class VecA, class VecB, int K=simd_kind<VecA, VecB>::value>
+		struct vector_comparer
+		{
+			template<typename TInt>
+			static bool equal(TInt n, const VecA& a, const VecB& b)
+			{
+				for (TInt i = 0; i < n; ++i)
+				{
+					if (!(a[i] == b[i])) return false;
+				}
+				return true;
+			}
+
+			template<typename TInt, typename Tol>
+			static bool approx(TInt n, const VecA& a, const VecB& b, const Tol& tol)
+			{
+				typedef typename std::decay<decltype(a[0] - b[0])>::type T;
+				typedef typename tol_kernel<T, Tol>::value_type V;
+				typename tol_kernel<T, Tol>::type k = bind_tol<T>(tol);
+
+				for (TInt i = 0; i < n; ++i)
+				{
+					if (!k(static_cast<V>(a[i]), static_cast<V>(b[i]))) return false;
+				}
+				return true;
+			}
+		};
+
+		template<class VecA, class VecB>
+		struct vector_comparer<VecA, VecB, 1>
+		{
+			template<typename TInt>
+			static bool equal(TInt n, const float *a, const float *b)
+			{
+				return !(n > 0) || internal::vec_equal((size_t)n, a, b);
+			}
+
+			template<typename TInt, typename Tol>
+			static bool approx(TInt n, const float *a, const float *b, const Tol& tol)
+			{
+				return !(n > 0) || approx_contiguous((size_t)n, a, b, make_tol_policy(tol));
+			}
+		};
+
+		template<class VecA, class VecB>
+		struct vector_comparer<VecA, VecB, 2>
+		{
+			template<typename TInt>
+			static bool equal(TInt n, const double *a, const double *b)
+			{
+				return !(n > 0) || internal::vec_equal((size_t)n, a, b);
+			}
+
+			template<typename TInt, typename Tol>
+			static bool approx(TInt n, const double *a, const double *b, const Tol& tol)
+			{
+				return !(n > 0) || approx_contiguous((size_t)n, a, b, make_tol_policy(tol));
+			}
+		};
+	}
+
+
+	// contiguous float/double arrays (given as pointers or arrays) are
+	// compared with SIMD kernels, other vectors through operator[]
+	//
+	// tol is either a tolerance policy (see tolerance.h) or a number,
+	// which is taken as a plain absolute tolerance (|a - b| <= tol)
+
 	template<typename TInt, class VecA, class VecB>
 	inline bool test_vector_equal(TInt n, const VecA& a, const VecB& b)
 	{
-		for (TInt i = 0; i < n; ++i)
+		return detail::vector_comparer<VecA, VecB>::equal(n, a, b);
+	}
+
+	template<typename TInt, typename T>
+	inline bool test_vector_equal(TInt n, const T *a, std::ptrdiff_t inca, const T *b, std::ptrdiff_t incb)
+	{
+		if (inca == 1 && incb == 1) return test_vector_equal(n, a, b);
+
+		for (TInt i = 0; i < n; ++i, a += inca, b += incb)
 		{
-			if (!(a[i] == b[i])) return false;
+			if (!(*a == *b)) return false;
 		}
 		return true;
 	}
@@ -86,12 +246,23 @@ namespace ltest
         return true;
     }
 
-	template<typename TInt, class VecA, class VecB, typename T>
-	inline bool test_vector_approx(TInt n, const VecA& a, const VecB& b, T tol)
+	template<typename TInt, class VecA, class VecB, typename Tol>
+	inline bool test_vector_approx(TInt n, const VecA& a, const VecB& b, const Tol& tol)
+	{
+		return detail::vector_comparer<VecA, VecB>::approx(n, a, b, tol);
+	}
+
+	template<typename TInt, typename T, typename Tol>
+	inline bool test_vector_approx(TInt n, const T *a, std::ptrdiff_t inca, const T *b, std::ptrdiff_t incb, const Tol& tol)
 	{
-		for (TInt i = 0; i < n; ++i)
+		if (inca == 1 && incb == 1) return test_vector_approx(n, a, b, tol);
+
+		typedef typename detail::tol_kernel<T, Tol>::value_type V;
+		typename detail::tol_kernel<T, Tol>::type k = detail::bind_tol<T>(tol);
+
+		for (TInt i = 0; i < n; ++i, a += inca, b += incb)
 		{
-			if (!( std::fabs(a[i] - b[i]) <= tol )) return false;
+			if (!k(static_cast<V>(*a), static_cast<V>(*b))) return false;
 		}
 		return true;
 	}
@@ -109,6 +280,20 @@ namespace ltest
 		return true;
 	}
 
+	// column-major matrices in memory, with leading dimensions lda and ldb
+
+	template<typename TInt, typename T>
+	inline bool test_matrix_equal(TInt m, TInt n, const T *a, TInt lda, const T *b, TInt ldb)
+	{
+		if (lda == m && ldb == m) return test_vector_equal(m * n, a, b);
+
+		for (TInt j = 0; j < n; ++j, a += lda, b += ldb)
+		{
+			if (!test_vector_equal(m, a, b)) return false;
+		}
+		return true;
+	}
+
     template<typename TInt, class MatA, typename T>
     inline bool test_matrix_equals(TInt m, TInt n, const MatA& a, const T& v)
     {
@@ -122,19 +307,35 @@ namespace ltest
         return true;
     }
 
-	template<typename TInt, class MatA, class MatB, typename T>
-	inline bool test_matrix_approx(TInt m, TInt n, const MatA& a, const MatB& b, T tol)
+	template<typename TInt, class MatA, class MatB, typename Tol>
+	inline bool test_matrix_approx(TInt m, TInt n, const MatA& a, const MatB& b, const Tol& tol)
 	{
+		typedef typename std::decay<decltype(a(0, 0) - b(0, 0))>::type T;
+		typedef typename detail::tol_kernel<T, Tol>::value_type V;
+		typename detail::tol_kernel<T, Tol>::type k = detail::bind_tol<T>(tol);
+
 		for (TInt j = 0; j < n; ++j)
 		{
 			for (TInt i = 0; i < m; ++i)
 			{
-				if (!( std::fabs(a(i,j) - b(i,j)) <= tol )) return false;
+				if (!k(static_cast<V>(a(i, j)), static_cast<V>(b(i, j)))) return false;
 			}
 		}
 		return true;
 	}
 
+	template<typename TInt, typename T, typename Tol>
+	inline bool test_matrix_approx(TInt m, TInt n, const T *a, TInt lda, const T *b, TInt ldb, const Tol& tol)
+	{
+		if (lda == m && ldb == m) return test_vector_approx(m * n, a, b, tol);
+
+		for (TInt j = 0; j < n; ++j, a += lda, b += ldb)
+		{
+			if (!test_vector_approx(m, a, b, tol)) return false;
+		}
+		return true;
+	}
+
 }
 
 /************************************************
@@ -155,12 +356,24 @@ namespace ltest
 #define ASSERT_NE( a, b ) \
 	if (!((a) != (b))) throw ::ltest::assertion_failure(__FILE__, __LINE__, #a " != " #b)
 
+// tol is either a tolerance policy (see tolerance.h) or an absolute tolerance,
+// with which the test is |a - b| <= tol (so equal infinities do not match)
 #define ASSERT_APPROX( a, b, tol ) \
-	if (!( std::fabs((a) - (b)) <= tol )) throw ::ltest::assertion_failure(__FILE__, __LINE__, #a " ~= " #b)
+	if (!::ltest::test_approx(a, b, tol)) throw ::ltest::assertion_failure(__FILE__, __LINE__, #a " ~= " #b)
+
+#define ASSERT_APPROX_REL( a, b, rtol ) \
+	if (!::ltest::test_approx(a, b, ::ltest::rel_tol(rtol))) \
+		throw ::ltest::assertion_failure(__FILE__, __LINE__, #a " ~= " #b " (rel tol = " #rtol ")")
 
 #define ASSERT_ULP( a, b, dtol ) \
 	if ( ::ltest::ulp_distance(a, b) > dtol ) throw ::ltest::assertion_failure(__FILE__, __LINE__, "ULP(" #a ", " #b ") <= " #dtol)
 
+// dtol is a number of ULPs here (see ulp_diff), rather than a number of bits
+#define ASSERT_VEC_ULP( n, a, b, dtol ) \
+	if ( ::ltest::max_ulp_diff(n, a, b) > (dtol) ) \
+		throw ::ltest::assertion_failure(__FILE__, __LINE__, "ULP(" #a "[0:" #n "], " #b "[0:" #n "]) <= " #dtol, \
+				::ltest::vector_ulp_mismatches(n, a, b, dtol) )
+
 #define ASSERT_CT_VALUE( T, V ) \
 	if (!((T::value) == (V))) throw ::ltest::assertion_failure(__FILE__, __LINE__, #T "::value == " #V)
 
@@ -172,27 +385,45 @@ namespace ltest
 
 #define ASSERT_VEC_EQ( n, a, b ) \
 	if (!::ltest::test_vector_equal(n, a, b)) \
-		throw ::ltest::assertion_failure(__FILE__, __LINE__, #a "[0:" #n "] == " #b "[0:" #n "]" )
+		throw ::ltest::assertion_failure(__FILE__, __LINE__, #a "[0:" #n "] == " #b "[0:" #n "]", \
+				::ltest::vector_mismatches(n, a, b).str() )
 
 #define ASSERT_VEC_EQS( n, a, v ) \
     if (!::ltest::test_vector_equals(n, a, v)) \
-        throw ::ltest::assertion_failure(__FILE__, __LINE__, #a "[0:" #n "] == " #v )
+        throw ::ltest::assertion_failure(__FILE__, __LINE__, #a "[0:" #n "] == " #v, \
+                ::ltest::vector_value_mismatches(n, a, v).str() )
 
 #define ASSERT_MAT_EQ( m, n, a, b ) \
 	if (!::ltest::test_matrix_equal(m, n, a, b)) \
-		throw ::ltest::assertion_failure(__FILE__, __LINE__, #a "[0:" #m ", 0:" #n "] == " #b "[0:" #m ", 0:" #n "]")
+		throw ::ltest::assertion_failure(__FILE__, __LINE__, #a "[0:" #m ", 0:" #n "] == " #b "[0:" #m ", 0:" #n "]", \
+				::ltest::matrix_mismatches(m, n, a, b).str() )
 
 #define ASSERT_MAT_EQS( m, n, a, v ) \
-    if (!::ltest::test_matrix_equals(m, n, v)) \
-        throw ::ltest::assertion_failure(__FILE__, __LINE__, #a "[0:" #m ", 0:" #n "] == " #v )
+    if (!::ltest::test_matrix_equals(m, n, a, v)) \
+        throw ::ltest::assertion_failure(__FILE__, __LINE__, #a "[0:" #m ", 0:" #n "] == " #v, \
+                ::ltest::matrix_value_mismatches(m, n, a, v).str() )
 
 #define ASSERT_VEC_APPROX( n, a, b, tol ) \
 	if (!::ltest::test_vector_approx(n, a, b, tol)) \
-		throw ::ltest::assertion_failure(__FILE__, __LINE__, #a "[0:" #n "] ~= " #b "[0:" #n "]" )
+		throw ::ltest::assertion_failure(__FILE__, __LINE__, #a "[0:" #n "] ~= " #b "[0:" #n "]", \
+				::ltest::vector_mismatches(n, a, b, tol).str() )
 
 #define ASSERT_MAT_APPROX( m, n, a, b, tol ) \
 	if (!::ltest::test_matrix_approx(m, n, a, b, tol)) \
-		throw ::ltest::assertion_failure(__FILE__, __LINE__, #a "[0:" #m ", 0:" #n "] ~= " #b "[0:" #m ", 0:" #n "]")
+		throw ::ltest::assertion_failure(__FILE__, __LINE__, #a "[0:" #m ", 0:" #n "] ~= " #b "[0:" #m ", 0:" #n "]", \
+				::ltest::matrix_mismatches(m, n, a, b, tol).str() )
+
+#define ASSERT_VEC_APPROX_REL( n, a, b, rtol ) \
+	if (!::ltest::test_vector_approx(n, a, b, ::ltest::rel_tol(rtol))) \
+		throw ::ltest::assertion_failure(__FILE__, __LINE__, \
+				#a "[0:" #n "] ~= " #b "[0:" #n "] (rel tol = " #rtol ")", \
+				::ltest::vector_mismatches(n, a, b, ::ltest::rel_tol(rtol)).str() )
+
+#define ASSERT_MAT_APPROX_REL( m, n, a, b, rtol ) \
+	if (!::ltest::test_matrix_approx(m, n, a, b, ::ltest::rel_tol(rtol))) \
+		throw ::ltest::assertion_failure(__FILE__, __LINE__, \
+				#a "[0:" #m ", 0:" #n "] ~= " #b "[0:" #m ", 0:" #n "] (rel tol = " #rtol ")", \
+				::ltest::matrix_mismatches(m, n, a, b, ::ltest::rel_tol(rtol)).str() )
 
 
 #endif /* TEST_ASSERTIONS_H_ */
@@ -14,17 +14,34 @@
 #define LIGHT_TEST_TEST_EXEC_H_
 
 #include "test_assertions.h"
+#include "expectations.h"
 #include "test_units.h"
 #include "test_mon.h"
 
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
 namespace ltest
 {
 
-	inline bool execute_case(test_case& tcase, test_monitor& mon)
+	/**
+	 * The executors are templates over the monitor type. With a
+	 * test_monitor reference the callbacks are dispatched virtually,
+	 * with a concrete (non-virtual) monitor such as
+	 * static_composite_monitor they can be inlined.
+	 */
+
+	template<class Monitor>
+	inline bool execute_case(test_case& tcase, Monitor& mon)
 	{
 		bool passed = true;
 		mon.on_case_begin(tcase);
 
+		expectation_log& elog = current_expectations();
+		elog.clear();
+
 		try
 		{
 			tcase.set_up();
@@ -46,46 +63,482 @@ namespace ltest
 			mon.on_exception(e);
 		}
 
+		if (!elog.empty())
+		{
+			passed = false;
+			mon.on_expectation_failures(elog);
+		}
+
 		mon.on_case_end(tcase, passed);
 		return passed;
 	}
 
 
-	inline size_t execute_pack(test_pack& tpack, test_monitor& mon)
+	/**
+	 * Selects test cases by a pattern of the form "pack" or
+	 * "pack.case", where '*' matches any sequence of characters
+	 * and '?' matches a single character.
+	 *
+	 * Cases are matched by the names the monitors show, i.e. their
+	 * name(). For cases added with ADD_TESTCASE, this takes constructing
+	 * them once more (before the fixtures are set up) when a pattern is
+	 * given; a case whose constructor throws is matched by its class
+	 * name. Without a pattern, no case is constructed to be selected.
+	 */
+	class test_filter
 	{
-		size_t n = tpack.size();
-		size_t npassed = 0;
+	public:
+		test_filter()
+		: m_all(true)
+		{
+		}
 
-		mon.on_pack_begin(tpack);
+		explicit test_filter(const char *pattern)
+		: m_all(!pattern || !*pattern)
+		{
+			if (!m_all)
+			{
+				const char *dot = std::strchr(pattern, '.');
+				if (dot)
+				{
+					m_pack_pat.assign(pattern, (size_t)(dot - pattern));
+					m_case_pat = dot + 1;
+				}
+				else
+				{
+					m_pack_pat = pattern;
+					m_case_pat = "*";
+				}
+			}
+		}
 
-		for (size_t i = 0; i < n; ++i)
+		bool selects_all() const
 		{
-			if (execute_case(tpack.tcase(i), mon)) ++npassed;
+			return m_all;
 		}
 
-		mon.on_pack_end(tpack, npassed);
-		return npassed;
+		bool select_pack(const char *pack_name) const
+		{
+			return m_all || wildcard_match(m_pack_pat.c_str(), pack_name);
+		}
+
+		bool select_case(const char *case_name) const
+		{
+			return m_all || wildcard_match(m_case_pat.c_str(), case_name);
+		}
+
+		static bool wildcard_match(const char *pat, const char *s)
+		{
+			const char *star = 0;
+			const char *s_star = 0;
+
+			while (*s)
+			{
+				if (*pat == '?' || (*pat != '*' && *pat == *s))
+				{
+					++pat;
+					++s;
+				}
+				else if (*pat == '*')
+				{
+					star = pat++;
+					s_star = s;
+				}
+				else if (star)
+				{
+					pat = star + 1;
+					s = ++s_star;
+				}
+				else return false;
+			}
+
+			while (*pat == '*') ++pat;
+			return !*pat;
+		}
+
+	private:
+		bool m_all;
+		std::string m_pack_pat;
+		std::string m_case_pat;
+
+	}; // end class test_filter
+
+
+	namespace detail
+	{
+		// stands for a case that could not run (e.g. a lazily constructed
+		// case whose constructor threw), and fails with the reason
+
+		class failing_case : public test_case
+		{
+		public:
+			failing_case(const std::string& name, const std::string& msg)
+			: m_name(name), m_msg(msg)
+			{
+			}
+
+			const char *name() const
+			{
+				return m_name.c_str();
+			}
+
+			void run()
+			{
+				throw std::runtime_error(m_msg);
+			}
+
+		private:
+			std::string m_name;
+			std::string m_msg;
+		};
+
+		struct scoped_test_case
+		{
+			test_case *p;
+
+			explicit scoped_test_case(test_case *p_) : p(p_) { }
+			~scoped_test_case() { delete p; }
+
+		private:
+			scoped_test_case(const scoped_test_case& );
+			scoped_test_case& operator = (const scoped_test_case& );
+		};
+
+
+		/**
+		 * Marks the selected cases of a pack, in the order they run
+		 * (sel is left empty if all are), and returns their number
+		 */
+		inline size_t select_cases(const test_pack& tpack, const test_filter& filter, std::vector<bool>& sel)
+		{
+			sel.clear();
+			if (filter.selects_all()) return tpack.size();
+
+			for (size_t i = 0; i < tpack.num_entries(); ++i)
+			{
+				const test_entry_ref& r = tpack.entry(i);
+				switch (r.kind)
+				{
+				case test_entry_ref::CASE_OBJECT:
+					sel.push_back(filter.select_case(tpack.tcase(r.slot).name()));
+					break;
+
+				case test_entry_ref::CASE_FACTORY:
+					// by the registered name, so that no case is constructed
+					sel.push_back(filter.select_case(tpack.tfactory(r.slot).name));
+					break;
+
+				case test_entry_ref::CASE_FUNC:
+					sel.push_back(filter.select_case(tpack.tfunc(r.slot).name));
+					break;
+
+				case test_entry_ref::CASE_GROUP:
+					{
+						const test_case_group& g = tpack.tgroup(r.slot);
+						for (size_t j = 0; j < g.size(); ++j) sel.push_back(filter.select_case(g.case_name(j)));
+					}
+					break;
+				}
+			}
+			return (size_t)std::count(sel.begin(), sel.end(), true);
+		}
+
+		inline bool next_selected(const std::vector<bool>& sel, size_t& k)
+		{
+			bool b = sel.empty() || sel[k];
+			++k;
+			return b;
+		}
+
+		// EXPECT_* failures of a fixture are reported when its call returns
+		// (they do not make the set_up fail)
+
+		template<class Monitor>
+		inline void report_fixture_expectations(Monitor& mon)
+		{
+			expectation_log& elog = current_expectations();
+			if (!elog.empty())
+			{
+				mon.on_expectation_failures(elog);
+				elog.clear();
+			}
+		}
+
+		template<class Monitor>
+		inline bool fixture_set_up(test_fixture *pf, Monitor& mon)
+		{
+			if (!pf) return true;
+
+			bool ok = false;
+			current_expectations().clear();
+			try
+			{
+				pf->set_up();
+				ok = true;
+			}
+			catch( assertion_failure& e)
+			{
+				mon.on_assertion_failure(e);
+			}
+			catch( std::exception& e)
+			{
+				mon.on_exception(e);
+			}
+			report_fixture_expectations(mon);
+			return ok;
+		}
+
+		template<class Monitor>
+		inline void fixture_tear_down(test_fixture *pf, Monitor& mon)
+		{
+			if (!pf) return;
+
+			current_expectations().clear();
+			try
+			{
+				pf->tear_down();
+			}
+			catch( assertion_failure& e)
+			{
+				mon.on_assertion_failure(e);
+			}
+			catch( std::exception& e)
+			{
+				mon.on_exception(e);
+			}
+			report_fixture_expectations(mon);
+		}
+
+		// makes a fixture current within a scope
+
+		class fixture_scope
+		{
+		public:
+			fixture_scope(test_fixture*& slot, test_fixture *pf)
+			: m_slot(slot), m_prev(slot)
+			{
+				m_slot = pf;
+			}
+
+			~fixture_scope()
+			{
+				m_slot = m_prev;
+			}
+
+		private:
+			fixture_scope(const fixture_scope& );
+			fixture_scope& operator = (const fixture_scope& );
+
+			test_fixture*& m_slot;
+			test_fixture *m_prev;
+		};
+
+
+		template<class Monitor>
+		inline bool execute_factory_case(const test_factory_entry& e, Monitor& mon)
+		{
+			test_case *p = 0;
+			try
+			{
+				p = e.factory();
+			}
+			catch( std::exception& ex)
+			{
+				failing_case fc(e.name, std::string("Failed to construct the test case: ") +
+						(ex.what() != 0 ? ex.what() : "Unknown cause"));
+				return execute_case(fc, mon);
+			}
+			catch( ... )
+			{
+				failing_case fc(e.name, "Failed to construct the test case: Unknown exception");
+				return execute_case(fc, mon);
+			}
+
+			scoped_test_case guard(p);
+			return execute_case(*p, mon);
+		}
+
+		// reports each selected case as failed with the reason
+
+		template<class Monitor>
+		inline void fail_pack_cases(test_pack& tpack, const std::vector<bool>& sel, const char *reason, Monitor& mon)
+		{
+			size_t k = 0;
+			for (size_t i = 0; i < tpack.num_entries(); ++i)
+			{
+				const test_entry_ref& r = tpack.entry(i);
+				if (r.kind == test_entry_ref::CASE_GROUP)
+				{
+					const test_case_group& g = tpack.tgroup(r.slot);
+					for (size_t j = 0; j < g.size(); ++j)
+					{
+						if (next_selected(sel, k))
+						{
+							failing_case fc(g.case_name(j), reason);
+							execute_case(fc, mon);
+						}
+					}
+				}
+				else if (next_selected(sel, k))
+				{
+					const char *name =
+						r.kind == test_entry_ref::CASE_OBJECT ? tpack.tcase(r.slot).name() :
+						r.kind == test_entry_ref::CASE_FACTORY ? tpack.tfactory(r.slot).name :
+						tpack.tfunc(r.slot).name;
+
+					failing_case fc(name, reason);
+					execute_case(fc, mon);
+				}
+			}
+		}
+
+		/**
+		 * Runs the selected cases of a pack. With a skip reason (or if
+		 * the fixture fails to set up), no case runs, and each of them
+		 * is reported as failed.
+		 */
+		template<class Monitor>
+		inline size_t execute_pack_cases(test_pack& tpack, Monitor& mon, const test_filter& filter, size_t& nfinished,
+				const char *skip_reason = 0)
+		{
+			if (!filter.select_pack(tpack.name())) return 0;
+
+			std::vector<bool> sel;
+			size_t nsel = select_cases(tpack, filter, sel);
+			if (nsel == 0) return 0;
+
+			size_t npassed = 0;
+
+			mon.on_pack_selection(tpack, nsel);
+			mon.on_pack_begin(tpack);
+
+			test_fixture *pf = tpack.fixture();
+			if (skip_reason)
+			{
+				fail_pack_cases(tpack, sel, skip_reason, mon);
+			}
+			else if (!fixture_set_up(pf, mon))
+			{
+				fail_pack_cases(tpack, sel, "Not run: the pack fixture failed to set up.", mon);
+			}
+			else
+			{
+				fixture_scope scope(current_fixtures().pack_fixture, pf);
+
+				// all function cases run through one adapter
+				func_test_case fcase;
+				size_t k = 0;
+
+				for (size_t i = 0; i < tpack.num_entries(); ++i)
+				{
+					const test_entry_ref& r = tpack.entry(i);
+					switch (r.kind)
+					{
+					case test_entry_ref::CASE_OBJECT:
+						if (next_selected(sel, k))
+						{
+							if (execute_case(tpack.tcase(r.slot), mon)) ++npassed;
+						}
+						break;
+
+					case test_entry_ref::CASE_FACTORY:
+						if (next_selected(sel, k))
+						{
+							if (execute_factory_case(tpack.tfactory(r.slot), mon)) ++npassed;
+						}
+						break;
+
+					case test_entry_ref::CASE_FUNC:
+						if (next_selected(sel, k))
+						{
+							fcase.reset(tpack.tfunc(r.slot));
+							if (execute_case(fcase, mon)) ++npassed;
+						}
+						break;
+
+					case test_entry_ref::CASE_GROUP:
+						{
+							test_case_group& g = tpack.tgroup(r.slot);
+							for (size_t j = 0; j < g.size(); ++j)
+							{
+								if (next_selected(sel, k))
+								{
+									if (execute_case(g.select(j), mon)) ++npassed;
+								}
+							}
+						}
+						break;
+					}
+				}
+
+				// only a fixture that was set up is torn down
+				fixture_tear_down(pf, mon);
+			}
+
+			mon.on_pack_end(tpack, npassed);
+
+			nfinished += nsel;
+			return npassed;
+		}
 	}
 
 
-	inline size_t execute_suite(test_suite& tsuite, test_monitor& mon)
+	// a monitor can be given as a temporary (e.g. a static composite)
+
+	template<class Monitor>
+	inline size_t execute_pack(test_pack& tpack, Monitor&& mon, const test_filter& filter)
+	{
+		size_t nfinished = 0;
+		return detail::execute_pack_cases(tpack, mon, filter, nfinished);
+	}
+
+	template<class Monitor>
+	inline size_t execute_pack(test_pack& tpack, Monitor&& mon)
+	{
+		return execute_pack(tpack, mon, test_filter());
+	}
+
+
+	template<class Monitor>
+	inline size_t execute_suite(test_suite& tsuite, Monitor&& mon, const test_filter& filter)
 	{
 		size_t npassed = 0;
 		size_t nfinished = 0;
 
 		mon.on_suite_begin(tsuite);
 
-		for (size_t i = 0; i < tsuite.size(); ++i)
+		test_fixture *pf = tsuite.fixture();
+		if (detail::fixture_set_up(pf, mon))
+		{
+			detail::fixture_scope scope(detail::current_fixtures().suite_fixture, pf);
+
+			for (size_t i = 0; i < tsuite.size(); ++i)
+			{
+				npassed += detail::execute_pack_cases(tsuite.tpack(i), mon, filter, nfinished);
+			}
+
+			// only a fixture that was set up is torn down
+			detail::fixture_tear_down(pf, mon);
+		}
+		else
 		{
-			test_pack& tp = tsuite.tpack(i);
-			npassed += execute_pack(tp, mon);
-			nfinished += tp.size();
+			for (size_t i = 0; i < tsuite.size(); ++i)
+			{
+				detail::execute_pack_cases(tsuite.tpack(i), mon, filter, nfinished,
+						"Not run: the suite fixture failed to set up.");
+			}
 		}
 
 		mon.on_suite_end(tsuite, nfinished, npassed);
 		return npassed;
 	}
 
+	template<class Monitor>
+	inline size_t execute_suite(test_suite& tsuite, Monitor&& mon)
+	{
+		return execute_suite(tsuite, mon, test_filter());
+	}
+
 }
 
 #endif /* TEST_EXEC_H_ */
@@ -28,6 +28,10 @@ namespace ltest
 
 		virtual void on_suite_end(const test_suite& tsuite, size_t nfinished_cases, size_t npassed_cases) { }
 
+		// called before on_pack_begin, with the number of cases of the
+		// pack that are to run (fewer than its size under a filter)
+		virtual void on_pack_selection(const test_pack& tpack, size_t ncases) { }
+
 		virtual void on_pack_begin(const test_pack& tpack) { }
 
 		virtual void on_pack_end(const test_pack& tpack, size_t npassed_cases) { }
@@ -38,6 +42,9 @@ namespace ltest
 
 		virtual void on_assertion_failure(const assertion_failure& e) { }
 
+		// called before on_case_end if any EXPECT_* check of the case failed
+		virtual void on_expectation_failures(const expectation_log& log) { }
+
 		virtual void on_exception(const std::exception& e) { }
 	};
 
@@ -15,6 +15,7 @@
 
 #include "base.h"
 #include <vector>
+#include <stdexcept>
 
 namespace ltest
 {
@@ -35,6 +36,184 @@ namespace ltest
 	}; // end class test_case
 
 
+	/**
+	 * A fixture shared by all cases of a test pack (or a test suite).
+	 *
+	 * set_up is called once before the first case of the pack runs,
+	 * and tear_down once after the last. While the cases run, the
+	 * fixture can be accessed via pack_fixture<F>() (or
+	 * suite_fixture<F>()).
+	 */
+	class test_fixture
+	{
+	public:
+		virtual ~test_fixture() { }
+
+		virtual void set_up() { }
+
+		virtual void tear_down() { }
+
+	}; // end class test_fixture
+
+
+	namespace detail
+	{
+		struct fixture_context
+		{
+			test_fixture *suite_fixture;
+			test_fixture *pack_fixture;
+		};
+
+		inline fixture_context& current_fixtures()
+		{
+			static fixture_context ctx = { 0, 0 };
+			return ctx;
+		}
+	}
+
+	template<class F>
+	inline F& pack_fixture()
+	{
+		F *f = dynamic_cast<F*>(detail::current_fixtures().pack_fixture);
+		if (!f) throw std::logic_error("No pack fixture of the requested type is in effect.");
+		return *f;
+	}
+
+	template<class F>
+	inline F& suite_fixture()
+	{
+		F *f = dynamic_cast<F*>(detail::current_fixtures().suite_fixture);
+		if (!f) throw std::logic_error("No suite fixture of the requested type is in effect.");
+		return *f;
+	}
+
+
+	typedef test_case* (*test_factory_t)();
+
+	template<class TCase>
+	inline test_case* make_test_case()
+	{
+		return new TCase();
+	}
+
+	/**
+	 * A test case registered by its factory. The case object is
+	 * constructed only when it is executed, and destroyed right
+	 * after that. The case is filtered (and reported when it is not
+	 * run) by the registered name, which should agree with its name().
+	 */
+	struct test_factory_entry
+	{
+		const char *name;   // the registered name (used for filtering)
+		test_factory_t factory;
+	};
+
+
+	typedef void (*test_func_t)();
+
+	/**
+	 * A lightweight test case given by a plain function, which
+	 * reports failures by throwing (e.g. via the ASSERT_* macros).
+	 *
+	 * The entries are stored by value in their test pack. The name
+	 * and file strings are not copied, and should be static.
+	 */
+	struct test_func_entry
+	{
+		const char *name;
+		const char *file;
+		unsigned int line;
+		test_func_t func;
+	};
+
+
+	/**
+	 * Adapts a test function entry to the test_case interface.
+	 *
+	 * A single adapter can be re-targeted to run a sequence of
+	 * entries, so no object is allocated per entry.
+	 */
+	class func_test_case : public test_case
+	{
+	public:
+		func_test_case()
+		: m_entry(0)
+		{
+		}
+
+		explicit func_test_case(const test_func_entry& e)
+		: m_entry(&e)
+		{
+		}
+
+		void reset(const test_func_entry& e)
+		{
+			m_entry = &e;
+		}
+
+		const test_func_entry& entry() const
+		{
+			return *m_entry;
+		}
+
+		const char *name() const
+		{
+			return m_entry->name;
+		}
+
+		void run()
+		{
+			m_entry->func();
+		}
+
+	private:
+		const test_func_entry *m_entry;
+
+	}; // end class func_test_case
+
+
+	/**
+	 * A group of cases sharing one implementation, which differ only
+	 * by a parameter (see param_tests.h).
+	 *
+	 * A group stores its parameters by value, and runs them through
+	 * a single case object that is re-targeted by select.
+	 */
+	class test_case_group
+	{
+	public:
+		virtual ~test_case_group() { }
+
+		virtual size_t size() const = 0;
+
+		virtual const char *case_name(size_t i) const = 0;
+
+		// the case object running the i-th parameter
+		virtual test_case& select(size_t i) = 0;
+
+	}; // end class test_case_group
+
+
+
+	/**
+	 * Refers to a registered case (or group of cases) by its kind and
+	 * its position among the entries of that kind. A pack keeps these in
+	 * the order of registration, which is the order of execution.
+	 */
+	struct test_entry_ref
+	{
+		enum kind_t
+		{
+			CASE_OBJECT,
+			CASE_FACTORY,
+			CASE_FUNC,
+			CASE_GROUP
+		};
+
+		kind_t kind;
+		size_t slot;
+	};
+
 
 	class test_pack
 	{
@@ -57,16 +236,87 @@ namespace ltest
 			return m_name.c_str();
 		}
 
+		void set_fixture(test_fixture *pfixture)
+		{
+			m_fixture.reset(pfixture);
+		}
+
+		test_fixture *fixture() const
+		{
+			return m_fixture.get();
+		}
+
 		void add(test_case *pcase)
 		{
+			add_ref(test_entry_ref::CASE_OBJECT, m_cases.size());
 			m_cases.push_back(shared_ptr<test_case>(pcase));
 		}
 
+		void add(const char *name, test_factory_t factory)
+		{
+			test_factory_entry e = { name, factory };
+			add_ref(test_entry_ref::CASE_FACTORY, m_factories.size());
+			m_factories.push_back(e);
+		}
+
+		void add(const char *name, test_func_t func, const char *file = "", unsigned int line = 0)
+		{
+			test_func_entry e = { name, file, line, func };
+			add_ref(test_entry_ref::CASE_FUNC, m_funcs.size());
+			m_funcs.push_back(e);
+		}
+
+		void add(test_case_group *pgroup)
+		{
+			add_ref(test_entry_ref::CASE_GROUP, m_groups.size());
+			m_groups.push_back(shared_ptr<test_case_group>(pgroup));
+		}
+
+		void reserve_funcs(size_t n)
+		{
+			m_funcs.reserve(n);
+			m_order.reserve(m_order.size() + n);
+		}
+
 		size_t size() const
+		{
+			size_t n = m_cases.size() + m_factories.size() + m_funcs.size();
+			for (size_t i = 0; i < m_groups.size(); ++i) n += m_groups[i]->size();
+			return n;
+		}
+
+		// the number of registered entries (a group counts as one)
+		size_t num_entries() const
+		{
+			return m_order.size();
+		}
+
+		// the i-th entry, in the order of registration
+		const test_entry_ref& entry(size_t i) const
+		{
+			return m_order[i];
+		}
+
+		size_t num_case_objects() const
 		{
 			return m_cases.size();
 		}
 
+		size_t num_case_factories() const
+		{
+			return m_factories.size();
+		}
+
+		size_t num_case_funcs() const
+		{
+			return m_funcs.size();
+		}
+
+		size_t num_case_groups() const
+		{
+			return m_groups.size();
+		}
+
 		const test_case& tcase(size_t i) const
 		{
 			return *(m_cases[i]);
@@ -77,9 +327,41 @@ namespace ltest
 			return *(m_cases[i]);
 		}
 
+		const test_factory_entry& tfactory(size_t i) const
+		{
+			return m_factories[i];
+		}
+
+		const test_func_entry& tfunc(size_t i) const
+		{
+			return m_funcs[i];
+		}
+
+		const test_case_group& tgroup(size_t i) const
+		{
+			return *(m_groups[i]);
+		}
+
+		test_case_group& tgroup(size_t i)
+		{
+			return *(m_groups[i]);
+		}
+
+	private:
+		void add_ref(test_entry_ref::kind_t kind, size_t slot)
+		{
+			test_entry_ref r = { kind, slot };
+			m_order.push_back(r);
+		}
+
 	private:
 		std::string m_name;
+		shared_ptr<test_fixture> m_fixture;
+		std::vector<test_entry_ref> m_order;
 		std::vector<shared_ptr<test_case> > m_cases;
+		std::vector<test_factory_entry> m_factories;
+		std::vector<test_func_entry> m_funcs;
+		std::vector<shared_ptr<test_case_group> > m_groups;
 
 	}; // end class test_pack
 
@@ -103,6 +385,16 @@ namespace ltest
 			return m_name.c_str();
 		}
 
+		void set_fixture(test_fixture *pfixture)
+		{
+			m_fixture.reset(pfixture);
+		}
+
+		test_fixture *fixture() const
+		{
+			return m_fixture.get();
+		}
+
 		void add(test_pack *ppack)
 		{
 			m_packs.push_back(shared_ptr<test_pack>(ppack));
@@ -125,6 +417,7 @@ namespace ltest
 
 	private:
 		std::string m_name;
+		shared_ptr<test_fixture> m_fixture;
 		std::vector<shared_ptr<test_pack> > m_packs;
 
 	}; // end class test_suite
@@ -15,5 +15,6 @@
 
 #include "test_exec.h"   // this also include other useful headers
 #include "auto_suite.h"
+#include "param_tests.h"
 
 #endif /* TESTS_H_ */
@@ -77,12 +77,22 @@ namespace ltest
 		double m_ns;
 	};
 
+	/**
+	 * A timer that measures the time since start(), excluding the time
+	 * between each pause() and the next resume(). The part of a pause()
+	 * and resume() pair that falls within the measured time (e.g. the
+	 * call overheads) is measured once per process, and subtracted for
+	 * every pair.
+	 *
+	 * elapsed() should not be called while paused.
+	 */
 	class timer
 	{
 		typedef internal::timer_impl::time_type time_type;
 	public:
 		LTEST_ENSURE_INLINE
 		explicit timer( bool to_start = false )
+		: m_paused_ns(0.0), m_npauses(0)
 		{
 			if (to_start) start();
 		}
@@ -90,9 +100,26 @@ namespace ltest
 		LTEST_ENSURE_INLINE
 		void start()
 		{
+			m_paused_ns = 0.0;
+			m_npauses = 0;
 			m_impl.get_current_time(m_start_t);
 		}
 
+		LTEST_ENSURE_INLINE
+		void pause()
+		{
+			m_impl.get_current_time(m_pause_t);
+		}
+
+		LTEST_ENSURE_INLINE
+		void resume()
+		{
+			time_type t;
+			m_impl.get_current_time(t);
+			m_paused_ns += m_impl.calc_time_distance(m_pause_t, t);
+			++ m_npauses;
+		}
+
 		LTEST_ENSURE_INLINE
 		runtime_span elapsed() const
 		{
@@ -119,18 +146,135 @@ namespace ltest
 
 		LTEST_ENSURE_INLINE
 		double elapsed_nsecs() const
+		{
+			double r = raw_elapsed_nsecs();
+			if (m_npauses > 0)
+			{
+				r -= double(m_npauses) * pause_overhead_nsecs();
+				if (r < 0.0) r = 0.0;
+			}
+			return r;
+		}
+
+		// the measured time added by a pause() and resume() pair
+		static double pause_overhead_nsecs()
+		{
+			static const double r = measure_pause_overhead();
+			return r;
+		}
+
+	private:
+		LTEST_ENSURE_INLINE
+		double raw_elapsed_nsecs() const
 		{
 			time_type t;
 			m_impl.get_current_time(t);
-			return m_impl.calc_time_distance(m_start_t, t);
+			return m_impl.calc_time_distance(m_start_t, t) - m_paused_ns;
+		}
+
+		// the least time per pair, over runs of back-to-back pairs
+		static double measure_pause_overhead()
+		{
+			const int npairs = 100;
+			double r = 1.0e300;
+			for (int k = 0; k < 20; ++k)
+			{
+				timer tm(true);
+				for (int i = 0; i < npairs; ++i)
+				{
+					tm.pause();
+					tm.resume();
+				}
+				double t = tm.raw_elapsed_nsecs() / npairs;
+				if (t < r) r = t;
+			}
+			return r;
 		}
 
 	private:
 		time_type m_start_t;
+		time_type m_pause_t;
+		double m_paused_ns;
+		size_t m_npauses;
 		internal::timer_impl m_impl;
 	};
 
 
+	/**
+	 * A tick counter that is much cheaper to read than timer, for timing
+	 * individual calls. An interval is measured as end() - begin().
+	 *
+	 * The length of a tick is measured against timer on first use of
+	 * nsecs_per_tick (which takes about 10 ms).
+	 */
+	class cycle_clock
+	{
+	public:
+		typedef uint64_t tick_type;
+
+		LTEST_ENSURE_INLINE
+		static tick_type begin()
+		{
+			return internal::read_ticks_begin();
+		}
+
+		LTEST_ENSURE_INLINE
+		static tick_type end()
+		{
+			return internal::read_ticks_end();
+		}
+
+		// a cheaper read, which is not ordered against the code around
+		// it (for timestamps, rather than intervals of small pieces)
+		LTEST_ENSURE_INLINE
+		static tick_type now()
+		{
+			return internal::read_ticks();
+		}
+
+		static double nsecs_per_tick()
+		{
+			static const double r = calibrate();
+			return r;
+		}
+
+		// the smallest observed interval between begin() and end(),
+		// i.e. the cost of timing an empty piece of code
+		static tick_type overhead()
+		{
+			static const tick_type r = measure_overhead();
+			return r;
+		}
+
+	private:
+		static double calibrate()
+		{
+#ifdef LTEST_HAS_TSC
+			timer tm(true);
+			tick_type t0 = begin();
+			double ns;
+			while ((ns = tm.elapsed_nsecs()) < 1.0e7) { }
+			tick_type t1 = end();
+			return ns / double(t1 - t0);
+#else
+			return 1.0;
+#endif
+		}
+
+		static tick_type measure_overhead()
+		{
+			tick_type r = ~(tick_type)0;
+			for (int i = 0; i < 1000; ++i)
+			{
+				tick_type t0 = begin();
+				tick_type t1 = end();
+				if (t1 - t0 < r) r = t1 - t0;
+			}
+			return r;
+		}
+	};
+
+
 }
 
 #endif /* TIMER_H_ */
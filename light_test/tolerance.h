@@ -0,0 +1,439 @@
+/**
+ * @file tolerance.h
+ *
+ * Tolerance policies for approximate comparison
+ *
+ * A policy decides whether two values a and b are approximately equal:
+ *
+ * - abs_tol(t):        |a - b| <= t
+ * - rel_tol(r):        |a - b| <= r * max(|a|, |b|)
+ * - abs_rel_tol(t, r): |a - b| <= t + r * max(|a|, |b|)
+ * - ulp_tol(k):        ulp_diff(a, b) <= k
+ *
+ * Under all policies, a == b is accepted (so equal infinities match),
+ * and NaN never matches unless the policy is wrapped by equal_nan(),
+ * in which case two NaNs match each other. A plain number given as a
+ * tolerance (to the scalar, vector and matrix comparisons alike) keeps
+ * the original test |a - b| <= tol instead, under which equal
+ * infinities do not match.
+ *
+ * A policy is bound to an element type T (through bind<T>()) before
+ * use. The bound kernel evaluates a and b without branches, so that
+ * loops over contiguous arrays can be vectorized by the compiler.
+ *
+ * @author Dahua Lin
+ */
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#ifndef LIGHT_TEST_TOLERANCE_H_
+#define LIGHT_TEST_TOLERANCE_H_
+
+#include "float_accuracy.h"
+#include "str_template.h"
+
+#include <cmath>
+#include <limits>
+#include <type_traits>
+
+namespace ltest
+{
+	namespace detail
+	{
+		// converts a tolerance to T, rounding downward, such that
+		// (d <= tol_as<T>(tol)) is equivalent to (d <= tol) for any d of type T
+
+		template<typename T, typename Tol>
+		inline T tol_as(Tol tol)
+		{
+			T t = static_cast<T>(tol);
+			if (static_cast<long double>(t) > static_cast<long double>(tol))
+			{
+				t = std::nextafter(t, -std::numeric_limits<T>::infinity());
+			}
+			return t;
+		}
+
+		// the type in which values of type T are compared
+
+		template<typename T>
+		struct tol_value
+		{
+			typedef typename std::conditional<std::is_floating_point<T>::value, T, double>::type type;
+		};
+
+		template<typename T>
+		inline bool both_nan(T a, T b)
+		{
+			return (a != a) & (b != b);
+		}
+
+		// d is nonnegative here (the bound scales with the values, so an
+		// infinite difference would otherwise be within it)
+		template<typename T>
+		inline bool is_finite(T d)
+		{
+			return d < std::numeric_limits<T>::infinity();
+		}
+
+		template<typename T>
+		inline T max_abs(T a, T b)
+		{
+			T x = std::fabs(a);
+			T y = std::fabs(b);
+			return x > y ? x : y;
+		}
+	}
+
+
+	/************************************************
+	 *
+	 *  Policies
+	 *
+	 ************************************************/
+
+	template<bool EqualNaN=false>
+	class abs_tolerance
+	{
+	public:
+		template<typename T>
+		struct kernel
+		{
+			T atol;
+
+			bool operator() (T a, T b) const
+			{
+				return (a == b) | (std::fabs(a - b) <= atol) | (EqualNaN & detail::both_nan(a, b));
+			}
+		};
+
+	public:
+		explicit abs_tolerance(double atol)
+		: m_atol(atol)
+		{
+		}
+
+		double atol() const
+		{
+			return m_atol;
+		}
+
+		template<typename T>
+		kernel<T> bind() const
+		{
+			kernel<T> k = { detail::tol_as<T>(m_atol) };
+			return k;
+		}
+
+		abs_tolerance<true> with_equal_nan() const
+		{
+			return abs_tolerance<true>(m_atol);
+		}
+
+		std::string str() const
+		{
+			return sformat(m_atol, "abs tol = %g");
+		}
+
+	private:
+		double m_atol;
+	};
+
+
+	template<bool EqualNaN=false>
+	class rel_tolerance
+	{
+	public:
+		template<typename T>
+		struct kernel
+		{
+			T rtol;
+
+			bool operator() (T a, T b) const
+			{
+				T d = std::fabs(a - b);
+				return (a == b) | ((d <= rtol * detail::max_abs(a, b)) & detail::is_finite(d)) |
+						(EqualNaN & detail::both_nan(a, b));
+			}
+		};
+
+	public:
+		explicit rel_tolerance(double rtol)
+		: m_rtol(rtol)
+		{
+		}
+
+		double rtol() const
+		{
+			return m_rtol;
+		}
+
+		template<typename T>
+		kernel<T> bind() const
+		{
+			kernel<T> k = { static_cast<T>(m_rtol) };
+			return k;
+		}
+
+		rel_tolerance<true> with_equal_nan() const
+		{
+			return rel_tolerance<true>(m_rtol);
+		}
+
+		std::string str() const
+		{
+			return sformat(m_rtol, "rel tol = %g");
+		}
+
+	private:
+		double m_rtol;
+	};
+
+
+	template<bool EqualNaN=false>
+	class abs_rel_tolerance
+	{
+	public:
+		template<typename T>
+		struct kernel
+		{
+			T atol;
+			T rtol;
+
+			bool operator() (T a, T b) const
+			{
+				T d = std::fabs(a - b);
+				return (a == b) | ((d <= atol + rtol * detail::max_abs(a, b)) & detail::is_finite(d)) |
+						(EqualNaN & detail::both_nan(a, b));
+			}
+		};
+
+	public:
+		abs_rel_tolerance(double atol, double rtol)
+		: m_atol(atol), m_rtol(rtol)
+		{
+		}
+
+		double atol() const
+		{
+			return m_atol;
+		}
+
+		double rtol() const
+		{
+			return m_rtol;
+		}
+
+		template<typename T>
+		kernel<T> bind() const
+		{
+			kernel<T> k = { static_cast<T>(m_atol), static_cast<T>(m_rtol) };
+			return k;
+		}
+
+		abs_rel_tolerance<true> with_equal_nan() const
+		{
+			return abs_rel_tolerance<true>(m_atol, m_rtol);
+		}
+
+		std::string str() const
+		{
+			return sformat(m_atol, "abs tol = %g") + sformat(m_rtol, ", rel tol = %g");
+		}
+
+	private:
+		double m_atol;
+		double m_rtol;
+	};
+
+
+	// the distance here is a number of ULPs (see ulp_diff), and
+	// this policy only applies to float and double values
+
+	template<bool EqualNaN=false>
+	class ulp_tolerance
+	{
+	public:
+		template<typename T>
+		struct kernel
+		{
+			typedef typename internal::ulp_repr<T>::uint_t uint_t;
+			uint_t dtol;
+
+			bool operator() (T a, T b) const
+			{
+				// ulp_diff is 0 for two NaNs
+				return (internal::ulp_diff_scalar(a, b) <= dtol) & (EqualNaN | (a == a));
+			}
+		};
+
+	public:
+		explicit ulp_tolerance(uint64_t dtol)
+		: m_dtol(dtol)
+		{
+		}
+
+		uint64_t dtol() const
+		{
+			return m_dtol;
+		}
+
+		template<typename T>
+		kernel<T> bind() const
+		{
+			typedef typename kernel<T>::uint_t uint_t;
+			const uint_t umax = std::numeric_limits<uint_t>::max();
+
+			kernel<T> k = { m_dtol < (uint64_t)umax ? (uint_t)m_dtol : umax };
+			return k;
+		}
+
+		ulp_tolerance<true> with_equal_nan() const
+		{
+			return ulp_tolerance<true>(m_dtol);
+		}
+
+		std::string str() const
+		{
+			return sformat((unsigned long long)m_dtol, "ulp tol = %llu");
+		}
+
+	private:
+		uint64_t m_dtol;
+	};
+
+
+	inline abs_tolerance<> abs_tol(double atol)
+	{
+		return abs_tolerance<>(atol);
+	}
+
+	inline rel_tolerance<> rel_tol(double rtol)
+	{
+		return rel_tolerance<>(rtol);
+	}
+
+	inline abs_rel_tolerance<> abs_rel_tol(double atol, double rtol)
+	{
+		return abs_rel_tolerance<>(atol, rtol);
+	}
+
+	inline ulp_tolerance<> ulp_tol(uint64_t dtol)
+	{
+		return ulp_tolerance<>(dtol);
+	}
+
+	template<class Policy>
+	inline auto equal_nan(const Policy& p) -> decltype(p.with_equal_nan())
+	{
+		return p.with_equal_nan();
+	}
+
+
+	namespace detail
+	{
+		// a plain number as a tolerance: |a - b| <= atol, without
+		// accepting a == b first (false for equal infinities)
+
+		class plain_tolerance
+		{
+		public:
+			template<typename T>
+			struct kernel
+			{
+				T atol;
+
+				bool operator() (T a, T b) const
+				{
+					return std::fabs(a - b) <= atol;
+				}
+			};
+
+		public:
+			explicit plain_tolerance(double atol)
+			: m_atol(atol)
+			{
+			}
+
+			double atol() const
+			{
+				return m_atol;
+			}
+
+			template<typename T>
+			kernel<T> bind() const
+			{
+				kernel<T> k = { tol_as<T>(m_atol) };
+				return k;
+			}
+
+			std::string str() const
+			{
+				return sformat(m_atol, "tol = %g");
+			}
+
+		private:
+			double m_atol;
+		};
+
+		// a tolerance argument is either a policy, or a number
+		// that is taken as a plain absolute tolerance
+
+		template<typename Tol, bool IsArith=std::is_arithmetic<Tol>::value>
+		struct tol_policy
+		{
+			typedef Tol type;
+
+			static const Tol& get(const Tol& tol) { return tol; }
+		};
+
+		template<typename Tol>
+		struct tol_policy<Tol, true>
+		{
+			typedef plain_tolerance type;
+
+			static type get(Tol tol) { return type(static_cast<double>(tol)); }
+		};
+
+		template<typename Tol>
+		inline typename tol_policy<Tol>::type make_tol_policy(const Tol& tol)
+		{
+			return tol_policy<Tol>::get(tol);
+		}
+
+		// the kernel of a policy bound to the comparison type of T
+
+		template<typename T, typename Tol>
+		struct tol_kernel
+		{
+			typedef typename tol_policy<Tol>::type policy_type;
+			typedef typename tol_value<T>::type value_type;
+			typedef typename policy_type::template kernel<value_type> type;
+		};
+
+		template<typename T, typename Tol>
+		inline typename tol_kernel<T, Tol>::type bind_tol(const Tol& tol)
+		{
+			return make_tol_policy(tol).template bind<typename tol_kernel<T, Tol>::value_type>();
+		}
+	}
+
+
+	/**
+	 * Tests whether a and b are approximately equal, where tol is
+	 * either a policy or a plain absolute tolerance.
+	 */
+	template<typename A, typename B, typename Tol>
+	inline bool test_approx(const A& a, const B& b, const Tol& tol)
+	{
+		typedef typename std::common_type<A, B>::type T;
+		typedef typename detail::tol_value<T>::type V;
+
+		return detail::bind_tol<T>(tol)(static_cast<V>(a), static_cast<V>(b));
+	}
+
+}
+
+#endif /* TOLERANCE_H_ */
@@ -0,0 +1,78 @@
+/**
+ * @file trace_test_mon.h
+ *
+ * Testing monitor that writes a Chrome trace of a suite
+ *
+ * @author Dahua Lin
+ */
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#ifndef LIGHT_TEST_TRACE_TEST_MON_H_
+#define LIGHT_TEST_TRACE_TEST_MON_H_
+
+#include "test_units.h"
+#include "test_mon.h"
+#include "trace_zones.h"
+
+#include <cstdio>
+#include <deque>
+#include <fstream>
+#include <string>
+
+namespace ltest
+{
+
+	/**
+	 * Records every case as a trace zone named "pack.case", and writes
+	 * the trace (with the zones recorded by the cases themselves) to a
+	 * file when the suite ends. Case names are copied, as the cases may
+	 * not outlive their runs.
+	 */
+	class trace_test_monitor : public test_monitor
+	{
+	public:
+		explicit trace_test_monitor(const char *path)
+		: m_path(path), m_case_begin(0)
+		{
+		}
+
+		virtual void on_pack_begin(const test_pack& tpack)
+		{
+			m_pack_name = tpack.name();
+		}
+
+		virtual void on_case_begin(const test_case& tcase)
+		{
+			m_names.push_back(m_pack_name + "." + tcase.name());
+			m_case_begin = cycle_clock::now();
+		}
+
+		virtual void on_case_end(const test_case& tcase, bool is_passed)
+		{
+			record_trace_zone(m_names.back().c_str(), m_case_begin, cycle_clock::now());
+		}
+
+		virtual void on_suite_end(const test_suite& tsuite, size_t nfinished_cases, size_t npassed_cases)
+		{
+			std::ofstream out(m_path.c_str());
+			if (!out)
+			{
+				std::fprintf(stderr, "Failed to open the trace file %s\n", m_path.c_str());
+				return;
+			}
+			write_chrome_trace(out);
+		}
+
+	private:
+		std::string m_path;
+		std::string m_pack_name;
+		std::deque<std::string> m_names;	// a deque keeps the strings in place
+		uint64_t m_case_begin;
+	};
+
+}
+
+#endif /* TRACE_TEST_MON_H_ */
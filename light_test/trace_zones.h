@@ -0,0 +1,334 @@
+/**
+ * @file trace_zones.h
+ *
+ * @brief Scoped trace zones, exported as a Chrome trace
+ *
+ * LTEST_TRACE_ZONE("name") records the span of the enclosing scope,
+ * read by cycle_clock, into a ring buffer of the current thread. A thread
+ * takes (and registers) its buffer on its first zone. After that,
+ * recording a zone takes two reads of the clock and a few stores, without
+ * locks or allocation. When a buffer is full, the oldest zones are
+ * overwritten.
+ *
+ * With POSIX threads (where LTEST_HAS_TRACE_RECYCLING is defined), the
+ * buffer of a thread that exits is taken over by the next thread that
+ * records a zone, which appends to it under the same thread id (their
+ * zones do not overlap in time). The buffers then take capacity * 24
+ * bytes (1.5 MB by default) per thread alive at once, rather than per
+ * thread ever started. Elsewhere, every buffer is kept until the end of
+ * the program.
+ *
+ * write_chrome_trace writes the zones of all threads in the trace-event
+ * JSON format, which is shown as a timeline by chrome://tracing and by
+ * Perfetto. It should be called while no zones are being recorded (e.g.
+ * at the end of a suite, see trace_test_mon.h).
+ *
+ * Zone names are not copied, and should be static. With LTEST_NO_TRACE
+ * defined, the macro expands to nothing.
+ *
+ * @author Dahua Lin
+ */
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#ifndef LIGHT_TEST_TRACE_ZONES_H_
+#define LIGHT_TEST_TRACE_ZONES_H_
+
+#include "base.h"
+#include "timer.h"
+#include "str_template.h"
+
+#include <atomic>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define LTEST_HAS_TRACE_RECYCLING
+#include <pthread.h>
+#endif
+
+// the number of zones kept per thread (a power of 2), each buffer
+// takes 24 bytes per zone (1.5 MB with the default)
+#ifndef LTEST_TRACE_BUFFER_SIZE
+#define LTEST_TRACE_BUFFER_SIZE 65536
+#endif
+
+namespace ltest
+{
+
+	struct trace_event
+	{
+		const char *name;
+		uint64_t begin;		// in cycle_clock ticks
+		uint64_t end;
+	};
+
+
+	/**
+	 * The ring buffer of a thread, written by that thread only
+	 */
+	class trace_buffer
+	{
+	public:
+		static const size_t capacity = LTEST_TRACE_BUFFER_SIZE;
+
+		explicit trace_buffer(unsigned int tid)
+		: m_tid(tid), m_events(capacity), m_head(0)
+		{
+		}
+
+		unsigned int tid() const
+		{
+			return m_tid;
+		}
+
+		LTEST_ENSURE_INLINE
+		void add(const char *name, uint64_t t0, uint64_t t1)
+		{
+			uint64_t h = m_head.load(std::memory_order_relaxed);
+			trace_event& e = m_events[(size_t)h & (capacity - 1)];
+			e.name = name;
+			e.begin = t0;
+			e.end = t1;
+			m_head.store(h + 1, std::memory_order_release);
+		}
+
+		// the number of zones recorded (including the overwritten ones)
+		uint64_t total() const
+		{
+			return m_head.load(std::memory_order_acquire);
+		}
+
+		size_t size() const
+		{
+			uint64_t n = total();
+			return n < capacity ? (size_t)n : capacity;
+		}
+
+		// the i-th of the kept zones (oldest first)
+		const trace_event& operator[] (size_t i) const
+		{
+			uint64_t n = total();
+			uint64_t first = n < capacity ? 0 : n - capacity;
+			return m_events[(size_t)(first + i) & (capacity - 1)];
+		}
+
+		void clear()
+		{
+			m_head.store(0, std::memory_order_release);
+		}
+
+	private:
+		trace_buffer(const trace_buffer& );
+		trace_buffer& operator = (const trace_buffer& );
+
+		unsigned int m_tid;
+		std::vector<trace_event> m_events;
+		std::atomic<uint64_t> m_head;
+	};
+
+
+	namespace detail
+	{
+		// the buffers of all threads that have recorded a zone, which
+		// are kept (with their zones) until the end of the program, and
+		// those released by exited threads, to be taken over
+		class trace_registry
+		{
+		public:
+			trace_registry()
+			{
+#ifdef LTEST_HAS_TRACE_RECYCLING
+				m_has_key = pthread_key_create(&m_key, &trace_registry::on_thread_exit) == 0;
+#endif
+			}
+
+			~trace_registry()
+			{
+#ifdef LTEST_HAS_TRACE_RECYCLING
+				if (m_has_key) pthread_key_delete(m_key);
+#endif
+				for (size_t i = 0; i < m_buffers.size(); ++i) delete m_buffers[i];
+			}
+
+			// the buffer of a thread on its first zone
+			trace_buffer *acquire_buffer()
+			{
+				trace_buffer *b;
+				{
+					std::lock_guard<std::mutex> lock(m_mutex);
+					if (!m_released.empty())
+					{
+						b = m_released.back();
+						m_released.pop_back();
+					}
+					else
+					{
+						b = new trace_buffer((unsigned int)m_buffers.size() + 1);
+						m_buffers.push_back(b);
+					}
+				}
+#ifdef LTEST_HAS_TRACE_RECYCLING
+				// releases b when the thread exits
+				if (m_has_key) pthread_setspecific(m_key, b);
+#endif
+				return b;
+			}
+
+			std::vector<trace_buffer*> buffers()
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				return m_buffers;
+			}
+
+		private:
+			trace_registry(const trace_registry& );
+			trace_registry& operator = (const trace_registry& );
+
+			void release_buffer(trace_buffer *b)
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_released.push_back(b);
+			}
+
+			static void on_thread_exit(void *b);
+
+			std::mutex m_mutex;
+			std::vector<trace_buffer*> m_buffers;
+			std::vector<trace_buffer*> m_released;
+#ifdef LTEST_HAS_TRACE_RECYCLING
+			pthread_key_t m_key;
+			bool m_has_key;
+#endif
+		};
+
+		inline trace_registry& get_trace_registry()
+		{
+			static trace_registry r;
+			return r;
+		}
+
+		inline void trace_registry::on_thread_exit(void *b)
+		{
+			get_trace_registry().release_buffer(static_cast<trace_buffer*>(b));
+		}
+
+		inline trace_buffer& this_thread_trace()
+		{
+			static LTEST_THREAD_LOCAL trace_buffer *b = 0;
+			if (!b) b = get_trace_registry().acquire_buffer();
+			return *b;
+		}
+
+		inline std::string json_escape(const char *s)
+		{
+			std::string r;
+			for (; *s; ++s)
+			{
+				unsigned char c = (unsigned char)*s;
+				if (c == '"' || c == '\\') { r += '\\'; r += *s; }
+				else if (c < 0x20) r += sformat((unsigned int)c, "\\u%04x");
+				else r += *s;
+			}
+			return r;
+		}
+	}
+
+
+	LTEST_ENSURE_INLINE
+	inline void record_trace_zone(const char *name, uint64_t t0, uint64_t t1)
+	{
+		detail::this_thread_trace().add(name, t0, t1);
+	}
+
+	class trace_zone
+	{
+	public:
+		LTEST_ENSURE_INLINE
+		explicit trace_zone(const char *name)
+		: m_name(name), m_begin(cycle_clock::now())
+		{
+		}
+
+		LTEST_ENSURE_INLINE
+		~trace_zone()
+		{
+			record_trace_zone(m_name, m_begin, cycle_clock::now());
+		}
+
+	private:
+		trace_zone(const trace_zone& );
+		trace_zone& operator = (const trace_zone& );
+
+		const char *m_name;
+		uint64_t m_begin;
+	};
+
+
+	// discards the zones of all threads
+	inline void clear_trace()
+	{
+		std::vector<trace_buffer*> bufs = detail::get_trace_registry().buffers();
+		for (size_t i = 0; i < bufs.size(); ++i) bufs[i]->clear();
+	}
+
+	/**
+	 * Writes the zones as complete ("X") events, with times in
+	 * microseconds since the earliest zone, and a name for each thread
+	 */
+	inline void write_chrome_trace(std::ostream& out)
+	{
+		std::vector<trace_buffer*> bufs = detail::get_trace_registry().buffers();
+		const double tpn = cycle_clock::nsecs_per_tick();
+
+		uint64_t origin = ~(uint64_t)0;
+		for (size_t i = 0; i < bufs.size(); ++i)
+		{
+			const trace_buffer& b = *bufs[i];
+			for (size_t j = 0; j < b.size(); ++j)
+			{
+				if (b[j].begin < origin) origin = b[j].begin;
+			}
+		}
+
+		out << "{\"traceEvents\":[";
+		bool first = true;
+		for (size_t i = 0; i < bufs.size(); ++i)
+		{
+			const trace_buffer& b = *bufs[i];
+
+			out << (first ? "\n" : ",\n");
+			first = false;
+			out << sformat(b.tid(), "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,");
+			out << sformat(b.tid(), "\"args\":{\"name\":\"thread %u\"}}");
+
+			for (size_t j = 0; j < b.size(); ++j)
+			{
+				const trace_event& e = b[j];
+				double ts = double(e.begin - origin) * tpn * 1.0e-3;
+				double dur = double(e.end - e.begin) * tpn * 1.0e-3;
+
+				out << ",\n{\"name\":\"" << detail::json_escape(e.name) << "\",\"ph\":\"X\",\"pid\":1";
+				out << sformat(b.tid(), ",\"tid\":%u");
+				out << sformat(ts, ",\"ts\":%.3f") << sformat(dur, ",\"dur\":%.3f}");
+			}
+		}
+		out << "\n],\"displayTimeUnit\":\"ns\"}\n";
+	}
+
+}
+
+#define LTEST_TRACE_CONCAT_( a, b ) a##b
+#define LTEST_TRACE_CONCAT( a, b ) LTEST_TRACE_CONCAT_( a, b )
+
+#ifdef LTEST_NO_TRACE
+#define LTEST_TRACE_ZONE( Name )
+#else
+#define LTEST_TRACE_ZONE( Name ) \
+	::ltest::trace_zone LTEST_TRACE_CONCAT( _ltest_trace_zone_, __LINE__ )( Name )
+#endif
+
+#endif /* TRACE_ZONES_H_ */
@@ -10,9 +10,23 @@
 #define LTEST_MAINSUITE_NAME "Main"
 #include "../light_test/tests.h"
 #include "../light_test/std_test_mon.h"
+#include "../light_test/junit_test_mon.h"
+#include "../light_test/tap_test_mon.h"
+#include "../light_test/composite_test_mon.h"
+#include "../light_test/trace_test_mon.h"
+#include "../light_test/accuracy_sweep.h"
+#include "../light_test/property.h"
+#include "../light_test/fuzz_tests.h"
+
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <limits>
 
 #include <stdexcept>
+#include <string>
 #include <valarray>
+#include <vector>
 
 using namespace ltest;
 
@@ -83,49 +97,10 @@ struct NumTriple
 };
 
 
-template<typename T> struct type_names;
-
-template<> struct type_names<float>
-{
-	static const char *get() { return "float"; }
-};
-
-template<> struct type_names<double>
-{
-	static const char *get() { return "double"; }
-};
-
-#define MAX_TNAME_LEN 64
-
-
-template<typename T>
-class my_test_base : public test_case
-{
-	char m_name[MAX_TNAME_LEN];
-
-public:
-	my_test_base(const char *name)
-	{
-#if (defined(_WIN32) || defined(_WIN64))
-		::sprintf_s(m_name, MAX_TNAME_LEN, "%s [%s]", name, type_names<T>::get());
-#else
-		std::sprintf(m_name, "%s [%s]", name, type_names<T>::get());
-#endif
-	}
-
-	const char *name() const
-	{
-		return m_name;
-	}
-};
-
-
 template<typename T>
-class numpair_constructs : public my_test_base<T>
+class numpair_constructs : public test_case
 {
 public:
-	numpair_constructs() : my_test_base<T>("numpair_constructs") { }
-
 	void run()
 	{
 		NumPair<T> x;
@@ -134,11 +109,9 @@ public:
 };
 
 template<typename T>
-class numpair_arith : public my_test_base<T>
+class numpair_arith : public test_case
 {
 public:
-	numpair_arith() : my_test_base<T>("numpair_arith") { }
-
 	void run()
 	{
 		NumPair<T> x(5, 6);
@@ -150,11 +123,9 @@ public:
 };
 
 template<typename T>
-class numtriple_constructs : public my_test_base<T>
+class numtriple_constructs : public test_case
 {
 public:
-	numtriple_constructs() : my_test_base<T>("numtriple_constructs") { }
-
 	void run()
 	{
 		NumTriple<T> x;
@@ -163,11 +134,9 @@ public:
 };
 
 template<typename T>
-class numtriple_arith : public my_test_base<T>
+class numtriple_arith : public test_case
 {
 public:
-	numtriple_arith() : my_test_base<T>("numtriple_arith") { }
-
 	void run()
 	{
 		NumTriple<T> x(5, 6, 8);
@@ -179,11 +148,9 @@ public:
 };
 
 template<typename T>
-class numtriple_raise : public my_test_base<T>
+class numtriple_raise : public test_case
 {
 public:
-	numtriple_raise() : my_test_base<T>("numtriple_raise") { }
-
 	void run()
 	{
 		NumTriple<T> x;
@@ -193,13 +160,12 @@ public:
 
 
 template<typename T>
-class valarray_vec : public my_test_base<T>
+class valarray_vec : public test_case
 {
 public:
 	static const size_t N = 6;
 
-	valarray_vec()
-	: my_test_base<T>("valarray_compare"), x(N), y(N) { }
+	valarray_vec() : x(N), y(N) { }
 
 	std::valarray<T> x, y;
 
@@ -224,33 +190,380 @@ public:
 
 // organize test suites
 
+typedef type_list<float, double> real_types;
+
 AUTO_TPACK( numpair )
 {
-	ADD_TESTCASE( numpair_constructs<float> )
-	ADD_TESTCASE( numpair_constructs<double> )
-	ADD_TESTCASE( numpair_arith<float> )
-	ADD_TESTCASE( numpair_arith<double> )
+	ADD_TYPED_TESTCASES( numpair_constructs, real_types )
+	ADD_TYPED_TESTCASES( numpair_arith, real_types )
 }
 
 AUTO_TPACK( numtriple )
 {
-	ADD_TESTCASE( numtriple_constructs<float> )
-	ADD_TESTCASE( numtriple_constructs<double> )
-	ADD_TESTCASE( numtriple_arith<float> )
-	ADD_TESTCASE( numtriple_arith<double> )
-	ADD_TESTCASE( numtriple_raise<float> )
-	ADD_TESTCASE( numtriple_raise<double> )
+	ADD_TYPED_TESTCASES( numtriple_constructs, real_types )
+	ADD_TYPED_TESTCASES( numtriple_arith, real_types )
+	ADD_TYPED_TESTCASES( numtriple_raise, real_types )
 }
 
 AUTO_TPACK( valarray )
 {
-	ADD_TESTCASE( valarray_vec<float> )
-	ADD_TESTCASE( valarray_vec<double> )
+	ADD_TYPED_TESTCASES( valarray_vec, float, double )
+}
+
+// value-parameterized cases: one case for each row of the table
+
+struct numpair_sum_row
+{
+	int a, b, sum;
+};
+
+const numpair_sum_row numpair_sum_table[] =
+{
+	{ 0, 0, 0 },
+	{ 1, 2, 3 },
+	{ -4, 4, 0 }
+};
+
+void numpair_sum(const numpair_sum_row& r)
+{
+	NumPair<int> x(r.a, r.b);
+	NumPair<int> y(r.b, r.a);
+	ASSERT_EQ(x + y, NumPair<int>(r.sum, r.sum));
+}
+
+AUTO_TPACK( numpair_table )
+{
+	ADD_PARAM_TESTS( numpair_sum, numpair_sum_table )
+}
+
+// accuracy sweeps of math functions against higher-precision references
+
+void sqrt_float_sweep()
+{
+	sweep_result<float> r = sweep_float_range(
+			[](float x) { return std::sqrt((double)x); },
+			[](float x) { return std::sqrt(x); }, 1.0f, 1.0625f);
+
+	ASSERT_TRUE( r.num_checked > 0 );
+	ASSERT_TRUE( r.max_ulp == 0 );  // sqrt is correctly rounded
+}
+
+void exp_double_sweep()
+{
+	sweep_result<double> r = sweep_double_range(
+			[](double x) { return std::exp((long double)x); },
+			[](double x) { return std::exp(x); }, -20.0, 20.0, 100000);
+
+	ASSERT_TRUE( r.num_checked == 100000 );
+	ASSERT_TRUE( r.max_ulp <= 1 );
+}
+
+AUTO_TPACK( accuracy )
+{
+	ADD_TESTFUNC( sqrt_float_sweep )
+	ADD_TESTFUNC( exp_double_sweep )
+}
+
+// approximate comparison of infinities: a policy accepts equal values,
+// while a plain tolerance keeps the test |a - b| <= tol
+
+template<class F>
+bool assertion_fails(F f)
+{
+	try
+	{
+		f();
+	}
+	catch( assertion_failure& )
+	{
+		return true;
+	}
+	return false;
+}
+
+// a column-major 2 x 2 matrix
+struct mat2x2
+{
+	double v[4];
+
+	double operator() (int i, int j) const
+	{
+		return v[i + 2 * j];
+	}
+};
+
+void approx_infinities()
+{
+	const double inf = std::numeric_limits<double>::infinity();
+	ASSERT_APPROX( inf, inf, abs_tol(1.0e-12) );
+	ASSERT_APPROX( 1.0, 1.0 + 1.0e-14, 1.0e-12 );
+	ASSERT_TRUE( assertion_fails([&]() { ASSERT_APPROX( inf, inf, 1.0e-12 ); }) );
+
+	// contiguous arrays (compared with SIMD kernels), and other vectors
+	const int n = 40;
+	double x[n], y[n];
+	for (int i = 0; i < n; ++i) x[i] = y[i] = 0.5 * i;
+	x[35] = y[35] = inf;
+	std::vector<double> vx(x, x + n), vy(y, y + n);
+
+	ASSERT_VEC_APPROX( n, x, y, abs_tol(1.0e-12) );
+	ASSERT_VEC_APPROX( n, vx, vy, abs_tol(1.0e-12) );
+	ASSERT_TRUE( assertion_fails([&]() { ASSERT_VEC_APPROX( n, x, y, 1.0e-12 ); }) );
+	ASSERT_TRUE( assertion_fails([&]() { ASSERT_VEC_APPROX( n, vx, vy, 1.0e-12 ); }) );
+
+	const mat2x2 a = {{ 1.0, inf, 3.0, 4.0 }};
+	ASSERT_MAT_APPROX( 2, 2, a, a, abs_tol(1.0e-12) );
+	ASSERT_TRUE( assertion_fails([&]() { ASSERT_MAT_APPROX( 2, 2, a, a, 1.0e-12 ); }) );
+}
+
+// the other policies, each with a comparison that passes and one that fails
+
+void relative_tolerances()
+{
+	ASSERT_APPROX_REL( 1000.0, 1000.001, 1.0e-5 );
+	ASSERT_TRUE( assertion_fails([]() { ASSERT_APPROX_REL( 1.0e-9, 2.0e-9, 1.0e-5 ); }) );
+
+	const double x[4] = { 1.0, 10.0, 100.0, 1000.0 };
+	double y[4];
+	for (int i = 0; i < 4; ++i) y[i] = x[i] * (1.0 + 1.0e-7);
+
+	ASSERT_VEC_APPROX_REL( 4, x, y, 1.0e-6 );
+	ASSERT_TRUE( assertion_fails([&]() { ASSERT_VEC_APPROX_REL( 4, x, y, 1.0e-8 ); }) );
+
+	const mat2x2 a = {{ x[0], x[1], x[2], x[3] }};
+	const mat2x2 b = {{ y[0], y[1], y[2], y[3] }};
+	ASSERT_MAT_APPROX_REL( 2, 2, a, b, 1.0e-6 );
+	ASSERT_TRUE( assertion_fails([&]() { ASSERT_MAT_APPROX_REL( 2, 2, a, b, 1.0e-8 ); }) );
+}
+
+void abs_rel_tolerances()
+{
+	// the absolute part applies near zero, the relative part to large values
+	ASSERT_APPROX( 0.0, 1.0e-13, abs_rel_tol(1.0e-12, 1.0e-9) );
+	ASSERT_APPROX( 1.0e6, 1.0e6 + 1.0e-4, abs_rel_tol(1.0e-12, 1.0e-9) );
+	ASSERT_TRUE( assertion_fails([]() { ASSERT_APPROX( 1.0, 1.0 + 1.0e-6, abs_rel_tol(1.0e-12, 1.0e-9) ); }) );
+}
+
+void ulp_tolerances()
+{
+	const double a = 1.0;
+	const double b = std::nextafter(std::nextafter(a, 2.0), 2.0);
+	ASSERT_APPROX( a, b, ulp_tol(2) );
+	ASSERT_TRUE( assertion_fails([&]() { ASSERT_APPROX( a, b, ulp_tol(1) ); }) );
+
+	const float x[3] = { 1.0f, 2.0f, 3.0f };
+	const float y[3] = { 1.0f, std::nextafter(2.0f, 3.0f), 3.0f };
+	ASSERT_VEC_APPROX( 3, x, y, ulp_tol(1) );
+	ASSERT_TRUE( assertion_fails([&]() { ASSERT_VEC_APPROX( 3, x, y, ulp_tol(0) ); }) );
+}
+
+void nan_tolerances()
+{
+	const double nan = std::numeric_limits<double>::quiet_NaN();
+	ASSERT_APPROX( nan, nan, equal_nan(abs_tol(1.0e-12)) );
+	ASSERT_APPROX( nan, nan, equal_nan(ulp_tol(0)) );
+	ASSERT_TRUE( assertion_fails([&]() { ASSERT_APPROX( nan, nan, abs_tol(1.0e-12) ); }) );
+	ASSERT_TRUE( assertion_fails([&]() { ASSERT_APPROX( nan, nan, ulp_tol(0) ); }) );
+
+	const double x[3] = { 1.0, nan, 3.0 };
+	ASSERT_VEC_APPROX( 3, x, x, equal_nan(rel_tol(1.0e-9)) );
+	ASSERT_TRUE( assertion_fails([&]() { ASSERT_VEC_APPROX( 3, x, x, rel_tol(1.0e-9) ); }) );
+}
+
+AUTO_TPACK( tolerance )
+{
+	ADD_TESTFUNC( approx_infinities )
+	ADD_TESTFUNC( relative_tolerances )
+	ADD_TESTFUNC( abs_rel_tolerances )
+	ADD_TESTFUNC( ulp_tolerances )
+	ADD_TESTFUNC( nan_tolerances )
+}
+
+// soft assertions: an EXPECT_* failure is recorded, and the case goes on
+
+void expectations_hold()
+{
+	const double x[3] = { 1.0, 2.0, 3.0 };
+	const double y[3] = { 1.0, 2.0, 3.0 + 1.0e-14 };
+	const mat2x2 a = {{ 1.0, 2.0, 3.0, 4.0 }};
+	const mat2x2 o = {{ 0.0, 0.0, 0.0, 0.0 }};
+
+	EXPECT_TRUE( x[0] < x[1] );
+	EXPECT_FALSE( x[1] < x[0] );
+	EXPECT_EQ( NumPair<int>(1, 2) + NumPair<int>(3, 4), NumPair<int>(4, 6) );
+	EXPECT_NE( x[0], x[1] );
+	EXPECT_APPROX( 0.1 + 0.2, 0.3, 1.0e-12 );
+	EXPECT_APPROX_REL( 1000.0, 1000.001, 1.0e-5 );
+	EXPECT_ULP( 0.1 + 0.2, 0.3, 1 );
+	EXPECT_VEC_ULP( 3, x, y, 32 );
+	EXPECT_STREQ( "light", std::string("light").c_str() );
+	EXPECT_VEC_EQ( 2, x, y );
+	EXPECT_VEC_EQS( 4, o.v, 0.0 );
+	EXPECT_VEC_APPROX( 3, x, y, 1.0e-12 );
+	EXPECT_MAT_EQ( 2, 2, a, a );
+	EXPECT_MAT_EQS( 2, 2, o, 0.0 );
+	EXPECT_MAT_APPROX( 2, 2, a, a, abs_tol(1.0e-12) );
+}
+
+void expectations_fail()
+{
+	NumPair<int> x(5, 6);
+	NumPair<int> y(1, 2);
+
+	// both failures are reported (with the values of the operands),
+	// and the case fails when it ends
+	EXPECT_EQ( (x - y).b, 4 );
+	EXPECT_STREQ( "numpair", "numtriple" );
+	EXPECT_TRUE( (x + y) == NumPair<int>(6, 8) );
+}
+
+AUTO_TPACK( expectations )
+{
+	ADD_TESTFUNC( expectations_hold )
+	ADD_TESTFUNC( expectations_fail )
+}
+
+// fixtures: set up once before the first case of the suite (or of a
+// pack), and torn down after the last
+
+struct example_suite_fixture : public test_fixture
+{
+	std::string data_dir;
+
+	void set_up()
+	{
+		data_dir = "src/corpus";
+	}
+};
+
+AUTO_SUITE_FIXTURE( example_suite_fixture )
+
+struct squares_fixture : public test_fixture
+{
+	std::vector<int> squares;
+
+	void set_up()
+	{
+		for (int i = 0; i < 10; ++i) squares.push_back(i * i);
+	}
+
+	void tear_down()
+	{
+		squares.clear();
+	}
+};
+
+void squares_filled()
+{
+	ASSERT_EQ( pack_fixture<squares_fixture>().squares.size(), (size_t)10 );
+}
+
+void squares_values()
+{
+	const std::vector<int>& s = pack_fixture<squares_fixture>().squares;
+	for (size_t i = 0; i < s.size(); ++i) ASSERT_EQ( s[i], (int)(i * i) );
+}
+
+void suite_data_dir()
+{
+	ASSERT_STREQ( suite_fixture<example_suite_fixture>().data_dir.c_str(), "src/corpus" );
+}
+
+AUTO_TPACK_F( fixture, squares_fixture )
+{
+	ADD_TESTFUNC( squares_filled )
+	ADD_TESTFUNC( squares_values )
+	ADD_TESTFUNC( suite_data_dir )
+}
+
+// a fixture that fails to set up, on purpose: its cases do not run,
+// and are reported as failed
+
+struct unavailable_fixture : public test_fixture
+{
+	void set_up()
+	{
+		throw std::runtime_error("the resource is not available");
+	}
+};
+
+void uses_resource()
+{
+	ASSERT_TRUE( false );  // not reached
+}
+
+AUTO_TPACK_F( fixture_failure, unavailable_fixture )
+{
+	ADD_TESTFUNC( uses_resource )
+}
+
+// properties checked over generated inputs
+
+bool prop_reverse_twice(const std::vector<int>& v)
+{
+	LTEST_TRACE_ZONE( "reverse_twice" );  // the trials, on the threads running them
+
+	std::vector<int> r(v.rbegin(), v.rend());
+	std::vector<int> rr(r.rbegin(), r.rend());
+	return rr == v;
+}
+
+bool prop_abs_ordered(double x)
+{
+	return std::fabs(x) >= x && std::fabs(x) >= -x;
+}
+
+AUTO_TPACK( properties )
+{
+	ADD_PROPERTY( prop_reverse_twice, 1000, vector_of(int_gen<int>(), 0, 50) )
+	ADD_PROPERTY( prop_abs_ordered, 10000, float_gen<double>(-1.0e300, 1.0e300) )
+}
+
+// a fuzz target, replaying the corpus under src/corpus
+// (run example1 from the root of the repository)
+
+void fuzz_hex_roundtrip(const uint8_t *data, size_t size)
+{
+	const char *digits = "0123456789abcdef";
+	std::string hex;
+	for (size_t i = 0; i < size; ++i)
+	{
+		hex += digits[data[i] >> 4];
+		hex += digits[data[i] & 0xf];
+	}
+
+	ASSERT_EQ( hex.size(), 2 * size );
+	for (size_t i = 0; i < size; ++i)
+	{
+		unsigned int v = (unsigned int)(std::strchr(digits, hex[2*i]) - digits) * 16
+				+ (unsigned int)(std::strchr(digits, hex[2*i+1]) - digits);
+		ASSERT_EQ( v, (unsigned int)data[i] );
+	}
+}
+
+AUTO_TPACK( fuzz )
+{
+	ADD_FUZZ_TEST( fuzz_hex_roundtrip, "src/corpus/fuzz_hex_roundtrip" )
 }
 
 int main(int argc, char *argv[])
 {
-	std_test_main(auto_main_suite());
+	const char *filter = argc > 1 ? argv[1] : 0;
+	std_test_main(auto_main_suite(), filter);
+
+	// the same cases, reported for CI tools, with a trace
+	// of this run (in one run)
+
+	std::ofstream junit_out("example1_junit.xml");
+	std::ofstream tap_out("example1.tap");
+	junit_test_monitor junit_mon(junit_out);
+	tap_test_monitor tap_mon(tap_out);
+	trace_test_monitor trace_mon("example1_trace.json");
+
+	clear_trace();
+	execute_suite(auto_main_suite(), make_static_composite(junit_mon, tap_mon, trace_mon), test_filter(filter));
+
+	std::printf("Reports written to example1_junit.xml, example1.tap and example1_trace.json\n");
 }
 
 
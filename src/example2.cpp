@@ -7,9 +7,14 @@
  */
 
 #include "../light_test/benchmark.h"
+#include "../light_test/bench_group.h"
+#include "../light_test/numa_sweep.h"
 #include "../light_test/std_bench_mon.h"
 
+#include <algorithm>
 #include <cmath>
+#include <cstdlib>
+#include <vector>
 
 using namespace ltest;
 
@@ -32,6 +37,18 @@ struct bench_math_base
 	{
 		return _size;
 	}
+
+	// the memory traffic per element
+
+	double bytes_read() const
+	{
+		return sizeof(double);
+	}
+
+	double bytes_written() const
+	{
+		return sizeof(double);
+	}
 };
 
 
@@ -81,12 +98,130 @@ struct bench_sin : bench_math_base
 };
 
 
+struct bench_axpy
+{
+	size_t _size;
+	double _a;
+	const double *_x;
+	double *_y;
+
+	bench_axpy(size_t n, double a, const double *x, double *y)
+	: _size(n), _a(a), _x(x), _y(y) { }
+
+	const char* name() const
+	{
+		return "axpy";
+	}
+
+	size_t size() const
+	{
+		return _size;
+	}
+
+	double bytes_read() const
+	{
+		return 2 * sizeof(double);
+	}
+
+	double bytes_written() const
+	{
+		return sizeof(double);
+	}
+
+	double flops() const
+	{
+		return 2;
+	}
+
+	void operator() () const
+	{
+		for (size_t i = 0; i < _size; ++i) _y[i] += _a * _x[i];
+	}
+};
+
+// sorts a shuffled copy of the input in each call, where the
+// copying is excluded from the timing
+
+struct bench_sort
+{
+	std::vector<double> _input;
+	std::vector<double> _work;
+	unsigned int _seed;
+
+	explicit bench_sort(size_t n)
+	: _input(n), _work(n), _seed(0) { }
+
+	const char* name() const
+	{
+		return "sort";
+	}
+
+	size_t size() const
+	{
+		return _input.size();
+	}
+
+	void set_up()
+	{
+		std::srand(++_seed);
+		for (size_t i = 0; i < _input.size(); ++i) _input[i] = double(std::rand());
+	}
+
+	void run(timer& tm)
+	{
+		tm.pause();
+		std::copy(_input.begin(), _input.end(), _work.begin());
+		tm.resume();
+		std::sort(_work.begin(), _work.end());
+	}
+
+	void tear_down() { }
+};
+
+
+// scales an array, whose buffers are placed by the memory policy
+// of the thread that constructs the job (where they are first touched)
+
+struct bench_scale
+{
+	numa_array<double> _x;
+	mutable numa_array<double> _y;
+
+	explicit bench_scale(size_t n)
+	: _x(n, -1), _y(n, -1) { }
+
+	const char* name() const
+	{
+		return "scale";
+	}
+
+	size_t size() const
+	{
+		return _x.size();
+	}
+
+	double bytes_read() const
+	{
+		return sizeof(double);
+	}
+
+	double bytes_written() const
+	{
+		return sizeof(double);
+	}
+
+	void operator() () const
+	{
+		const size_t n = _x.size();
+		for (size_t i = 0; i < n; ++i) _y[i] = 2.0 * _x[i];
+	}
+};
 
 
 int main(int argc, char *argv[])
 {
 	const size_t N = 1000;
-	const char *templ_spec = "{{jobname : %-5s}}:  {{times: %10lu}}  | {{secs: %10.4f}} s  | {{mps: %10.2f}} MPS\n";
+	const char *templ_spec = "{{jobname : %-5s}}:  {{times: %10lu}}  | {{secs: %10.4f}} s  | {{mps: %10.2f}} MPS  | warmup {{warmup: %6lu}} calls ({{warmup_secs: %.3f}} s)\n";
 	std_bench_monitor mon(templ_spec);
 	benchmark_option opt(2000);
 
@@ -99,6 +234,48 @@ int main(int argc, char *argv[])
 	run_benchmark(bench_log (N, src, dst), mon, opt);
 	run_benchmark(bench_sin (N, src, dst), mon, opt);
 
+	std::cout << "\nrelative to sqrt:\n";
+	std_bench_monitor cmp_mon("{{jobname : %-5s}}:  {{mps: %10.2f}} MPS  | {{speedup: %7.3f}}x  [{{speedup_lo: %7.3f}}, {{speedup_hi: %7.3f}}]  in {{rounds}} rounds\n");
+	bench_group math_group;
+	math_group.add(bench_sqrt(N, src, dst))
+		.add(bench_exp (N, src, dst))
+		.add(bench_log (N, src, dst))
+		.add(bench_sin (N, src, dst));
+	math_group.run(cmp_mon, opt);
+
+	std::cout << "\nper-call latencies:\n";
+	std_bench_monitor lat_mon("{{jobname : %-5s}}:  {{times: %10lu}}  | p50 {{p50: %8.1f}}  p99 {{p99: %8.1f}}  p999 {{p999: %8.1f}}  max {{lat_max: %9.1f}} ns\n");
+	run_latency_benchmark(bench_sqrt(N, src, dst), lat_mon, opt);
+	run_latency_benchmark(bench_exp (N, src, dst), lat_mon, opt);
+
+	std::cout << "\nbandwidth and roofline:\n";
+	const size_t M = 4000000;
+	std::vector<double> x(M, 1.0), y(M, 0.0);
+	std_bench_monitor bw_mon("{{jobname : %-5s}}:  {{gbps: %6.2f}} GB/s  {{gflops: %6.2f}} GFLOP/s  | "
+			"{{roofline: %5.1f}}% of roofline (peak {{peak_gbps: %.2f}} GB/s, {{peak_gflops: %.2f}} GFLOP/s)\n");
+	run_benchmark(bench_sqrt(N, src, dst), bw_mon, opt);
+	run_benchmark(bench_axpy(M, 0.5, &x[0], &y[0]), bw_mon, benchmark_option(1));
+
+	std::cout << "\nNUMA placement:\n";
+	numa_sweep_result nr = run_numa_sweep([=]() { return bench_scale(M); }, bw_mon, benchmark_option(1));
+	if (nr.num_nodes() > 1) std::cout << "remote / local throughput: " << nr.remote() / nr.local() << "\n";
+
+	std::cout << "\nprofile of sin:\n";
+	sampling_profiler prof;
+	run_benchmark(bench_sin(N, src, dst), mon, benchmark_option(2000).set_profiler(&prof));
+	prof.print_top(std::cout, 5);
+
+	std::cout << "\nopen-loop load (sqrt):\n";
+	std_bench_monitor load_mon("{{offered: %9.0f}} /s offered  {{achieved: %9.0f}} /s achieved  | "
+			"p50 {{p50: %9.1f}}  p99 {{p99: %9.1f}}  max {{lat_max: %11.1f}} ns  (service p99 {{svc_p99: %.1f}} ns)\n");
+	double sat = run_load_sweep(bench_sqrt(N, src, dst), load_mon,
+			load_option(20000).set_duration(0.2).set_growth(2.0));
+	std::cout << "saturation at about " << sat << " calls/s\n\n";
+
+	std::cout << "\nfixtures:\n";
+	bench_sort sort_fx(N);
+	run_fixture_benchmark(sort_fx, mon, benchmark_option(20));
+
 	delete [] src;
 	delete [] dst;
 }